@@ -1,12 +1,21 @@
+use std::collections::HashMap;
 use std::convert::{TryFrom, TryInto};
 use std::ffi::{CStr, CString};
+use std::path::PathBuf;
 use std::ptr::null_mut;
+use std::sync::{Mutex, PoisonError};
 
+use lazy_static::lazy_static;
 use num_enum::{IntoPrimitive, TryFromPrimitive};
 
+use super::fingerprint::{self, FingerprintDiff, LongFormID};
 use super::modfile::{ModFile, ModFlags};
+use super::plugin::top_level_groups;
 use super::raw;
 use super::record::Record;
+use super::spatial::{SpatialFields, SpatialIndex};
+use super::types;
+use super::validate::{self, ValidationReport};
 
 #[derive(TryFromPrimitive, IntoPrimitive)]
 #[repr(i32)]
@@ -18,6 +27,11 @@ pub enum CollectionType {
     Unknown = raw::cb_game_type_t_CB_UNKNOWN_GAME_TYPE, // TODO this should not exist - auto-panic
 }
 
+lazy_static! {
+    /// Mods directory of each collection, which CBash does not expose.
+    static ref MODS_PATHS: Mutex<HashMap<usize, PathBuf>> = Mutex::new(HashMap::new());
+}
+
 pub struct Collection {
     pub(super) raw: *mut raw::cb_collection_t,
 }
@@ -33,6 +47,10 @@ impl Collection {
             let _string = CString::from_raw(c_path);
             c_col
         };
+        MODS_PATHS
+            .lock()
+            .unwrap_or_else(PoisonError::into_inner)
+            .insert(c_col as usize, PathBuf::from(path));
         Collection { raw: c_col }
     }
 
@@ -55,6 +73,36 @@ impl Collection {
         ModFile { raw: c_mod }
     }
 
+    /// Adds a plugin for loading only if it has records of the given types.
+    ///
+    /// The plugin's top-level groups are scanned first. If none of them can hold
+    /// one of `rec_types`, a full load is downgraded to a header-only load, since
+    /// the plugin cannot add or override records of those types. Nested types
+    /// count for the groups they live in, e.g. `REFR` for `CELL` and `WRLD`.
+    pub fn add_mod_filtered(&self, name: &str, flags: ModFlags, rec_types: &[[u8; 4]]) -> ModFile {
+        let mut flags = flags;
+        let path = self.mods_path().join(name);
+        let groups = top_level_groups(path.to_str().expect("Failed to parse mod path."));
+        let wanted: Vec<[u8; 4]> = rec_types
+            .iter()
+            .flat_map(|t| types::top_level_groups(*t))
+            .collect();
+        if flags.contains(ModFlags::FULL_LOAD) && !groups.iter().any(|g| wanted.contains(g)) {
+            flags.remove(ModFlags::FULL_LOAD);
+            flags.insert(ModFlags::MIN_LOAD);
+        }
+        self.add_mod(name, flags)
+    }
+
+    pub(super) fn mods_path(&self) -> PathBuf {
+        MODS_PATHS
+            .lock()
+            .unwrap_or_else(PoisonError::into_inner)
+            .get(&(self.raw as usize))
+            .cloned()
+            .expect("Failed to get collection's mods path.")
+    }
+
     pub fn mod_num(&self) -> i32 {
         unsafe {
             let mod_num = raw::cb_GetAllNumMods(self.raw);
@@ -67,13 +115,13 @@ impl Collection {
 
     pub fn mods(&self) -> Vec<ModFile> {
         let mod_num = self.mod_num();
-        let mut mods: Vec<raw::cb_mod_t> = Vec::with_capacity(mod_num.try_into().unwrap());
+        let mut mods: Vec<*mut raw::cb_mod_t> = vec![null_mut(); mod_num.try_into().unwrap()];
         unsafe {
-            if raw::cb_GetAllModIDs(self.raw, &mut mods.as_mut_ptr()).is_negative() {
+            if raw::cb_GetAllModIDs(self.raw, mods.as_mut_ptr()).is_negative() {
                 panic!("Failed to get mods in collection.")
             }
         }
-        mods.iter_mut().map(|m| ModFile { raw: m }).collect()
+        mods.into_iter().map(|raw| ModFile { raw }).collect()
     }
 
     pub fn load_order_num(&self) -> i32 {
@@ -88,13 +136,13 @@ impl Collection {
 
     pub fn load_order_mods(&self) -> Vec<ModFile> {
         let mod_num = self.load_order_num();
-        let mut mods: Vec<raw::cb_mod_t> = Vec::with_capacity(mod_num.try_into().unwrap());
+        let mut mods: Vec<*mut raw::cb_mod_t> = vec![null_mut(); mod_num.try_into().unwrap()];
         unsafe {
-            if raw::cb_GetLoadOrderModIDs(self.raw, &mut mods.as_mut_ptr()).is_negative() {
+            if raw::cb_GetLoadOrderModIDs(self.raw, mods.as_mut_ptr()).is_negative() {
                 panic!("Failed to get load order mods.")
             }
         }
-        mods.iter_mut().map(|m| ModFile { raw: m }).collect()
+        mods.into_iter().map(|raw| ModFile { raw }).collect()
     }
 
     pub fn file_name(&self, index: u32) -> &str {
@@ -161,6 +209,21 @@ impl Collection {
         res != 0
     }
 
+    /// Fingerprints the winning version of every record of `rec_type`.
+    pub fn fingerprints(&self, rec_type: [u8; 4]) -> HashMap<LongFormID, u64> {
+        fingerprint::collection_fingerprints(self, rec_type)
+    }
+
+    /// Compares the winning records of `rec_types` against an older collection by fingerprint.
+    pub fn diff(&self, old: &Collection, rec_types: &[[u8; 4]]) -> FingerprintDiff {
+        fingerprint::diff(old, self, rec_types)
+    }
+
+    /// Reports every FormID in the loaded records that points to a missing master or record.
+    pub fn validate_references(&self) -> ValidationReport {
+        validate::validate_references(self)
+    }
+
     pub fn load(&self) {
         // extern "C" fn c_callback(_a: u32, _b: u32, _c: *const ::std::os::raw::c_char) -> bool {
         //     true
@@ -172,6 +235,10 @@ impl Collection {
         }
     }
 
+    pub fn spatial_index(&self, fields: &SpatialFields) -> SpatialIndex {
+        SpatialIndex::new(self, fields)
+    }
+
     pub fn unload(&self) {
         unsafe {
             if raw::cb_UnloadCollection(self.raw).is_negative() {
@@ -191,6 +258,10 @@ impl Collection {
 
 impl Drop for Collection {
     fn drop(&mut self) {
+        MODS_PATHS
+            .lock()
+            .unwrap_or_else(PoisonError::into_inner)
+            .remove(&(self.raw as usize));
         unsafe {
             if raw::cb_DeleteCollection(self.raw).is_negative() {
                 panic!("Failed to delete collection.")
@@ -0,0 +1,463 @@
+use std::ffi::{c_void, CStr, CString};
+use std::os::raw::c_char;
+use std::ptr::null_mut;
+use std::slice;
+
+use super::plugin::read_u32;
+use super::raw;
+
+/// Field identifier of a record's header flags, shared by every record type.
+pub(super) const FLAGS_FIELD: u32 = 1;
+/// Field identifier of a record's own FormID, shared by every record type.
+pub(super) const FORMID_FIELD: u32 = 2;
+/// Field identifier of a record's EditorID, shared by every record type.
+pub(super) const EDITORID_FIELD: u32 = 4;
+
+/// Attribute of a field's type, as passed to `cb_GetFieldAttribute`.
+pub(super) const TYPE_ATTRIBUTE: u32 = 0;
+/// Attribute of a list or array field's length.
+pub(super) const SIZE_ATTRIBUTE: u32 = 1;
+/// Attribute of the actual type of a field whose type depends on its value,
+/// e.g. `CB_FORMID_OR_UINT32_FIELD`. Array elements follow, one per index.
+const VALUE_TYPE_ATTRIBUTE: u32 = 2;
+
+pub(super) fn attribute(rec: *mut raw::cb_record_t, path: [u32; 7], which: u32) -> u32 {
+    unsafe {
+        raw::cb_GetFieldAttribute(
+            rec, path[0], path[1], path[2], path[3], path[4], path[5], path[6], which,
+        )
+    }
+}
+
+/// Byte size of the fields CBash returns by pointer to a single value.
+pub(super) fn scalar_size(kind: u32) -> Option<usize> {
+    let kind = kind as raw::cb_field_type_t;
+    match kind {
+        raw::cb_field_type_t_CB_BOOL_FIELD
+        | raw::cb_field_type_t_CB_SINT8_FIELD
+        | raw::cb_field_type_t_CB_UINT8_FIELD
+        | raw::cb_field_type_t_CB_CHAR_FIELD
+        | raw::cb_field_type_t_CB_SINT8_FLAG_FIELD
+        | raw::cb_field_type_t_CB_SINT8_TYPE_FIELD
+        | raw::cb_field_type_t_CB_SINT8_FLAG_TYPE_FIELD
+        | raw::cb_field_type_t_CB_UINT8_FLAG_FIELD
+        | raw::cb_field_type_t_CB_UINT8_TYPE_FIELD
+        | raw::cb_field_type_t_CB_UINT8_FLAG_TYPE_FIELD => Some(1),
+        raw::cb_field_type_t_CB_SINT16_FIELD
+        | raw::cb_field_type_t_CB_UINT16_FIELD
+        | raw::cb_field_type_t_CB_SINT16_FLAG_FIELD
+        | raw::cb_field_type_t_CB_SINT16_TYPE_FIELD
+        | raw::cb_field_type_t_CB_SINT16_FLAG_TYPE_FIELD
+        | raw::cb_field_type_t_CB_UINT16_FLAG_FIELD
+        | raw::cb_field_type_t_CB_UINT16_TYPE_FIELD
+        | raw::cb_field_type_t_CB_UINT16_FLAG_TYPE_FIELD => Some(2),
+        raw::cb_field_type_t_CB_SINT32_FIELD
+        | raw::cb_field_type_t_CB_UINT32_FIELD
+        | raw::cb_field_type_t_CB_FLOAT32_FIELD
+        | raw::cb_field_type_t_CB_RADIAN_FIELD
+        | raw::cb_field_type_t_CB_FORMID_FIELD
+        | raw::cb_field_type_t_CB_MGEFCODE_FIELD
+        | raw::cb_field_type_t_CB_ACTORVALUE_FIELD
+        | raw::cb_field_type_t_CB_FORMID_OR_UINT32_FIELD
+        | raw::cb_field_type_t_CB_FORMID_OR_FLOAT32_FIELD
+        | raw::cb_field_type_t_CB_UINT8_OR_UINT32_FIELD
+        | raw::cb_field_type_t_CB_UNKNOWN_OR_FORMID_OR_UINT32_FIELD
+        | raw::cb_field_type_t_CB_UNKNOWN_OR_SINT32_FIELD
+        | raw::cb_field_type_t_CB_UNKNOWN_OR_UINT32_FLAG_FIELD
+        | raw::cb_field_type_t_CB_MGEFCODE_OR_CHAR4_FIELD
+        | raw::cb_field_type_t_CB_FORMID_OR_MGEFCODE_OR_ACTORVALUE_OR_UINT32_FIELD
+        | raw::cb_field_type_t_CB_RESOLVED_MGEFCODE_FIELD
+        | raw::cb_field_type_t_CB_STATIC_MGEFCODE_FIELD
+        | raw::cb_field_type_t_CB_RESOLVED_ACTORVALUE_FIELD
+        | raw::cb_field_type_t_CB_STATIC_ACTORVALUE_FIELD
+        | raw::cb_field_type_t_CB_CHAR4_FIELD
+        | raw::cb_field_type_t_CB_SINT32_FLAG_FIELD
+        | raw::cb_field_type_t_CB_SINT32_TYPE_FIELD
+        | raw::cb_field_type_t_CB_SINT32_FLAG_TYPE_FIELD
+        | raw::cb_field_type_t_CB_UINT32_FLAG_FIELD
+        | raw::cb_field_type_t_CB_UINT32_TYPE_FIELD
+        | raw::cb_field_type_t_CB_UINT32_FLAG_TYPE_FIELD => Some(4),
+        _ => None,
+    }
+}
+
+/// Reads a single value field, or `None` if the record lacks it.
+pub(super) fn read_scalar(
+    rec: *mut raw::cb_record_t,
+    path: [u32; 7],
+    size: usize,
+) -> Option<Vec<u8>> {
+    unsafe {
+        let value = raw::cb_GetField(
+            rec,
+            path[0],
+            path[1],
+            path[2],
+            path[3],
+            path[4],
+            path[5],
+            path[6],
+            null_mut::<*mut c_void>(),
+        );
+        if value.is_null() {
+            return None;
+        }
+        Some(slice::from_raw_parts(value as *const u8, size).to_vec())
+    }
+}
+
+pub(super) fn list_len(rec: *mut raw::cb_record_t, field: u32) -> u32 {
+    attribute(rec, [field, 0, 0, 0, 0, 0, 0], SIZE_ATTRIBUTE)
+}
+
+/// Resizes a list field, adding default entries or dropping trailing ones.
+pub(super) fn set_list_len(rec: *mut raw::cb_record_t, field: u32, len: u32) {
+    set_field(rec, [field, 0, 0, 0, 0, 0, 0], null_mut(), len)
+}
+
+/// Returns the parent record of a record nested in a group, such as a
+/// reference's `CELL`, or null if it has none.
+pub(super) fn parent_record(rec: *mut raw::cb_record_t) -> *mut raw::cb_record_t {
+    match first_field_of_type(rec, raw::cb_field_type_t_CB_PARENTRECORD_FIELD) {
+        Some(field) => unsafe {
+            raw::cb_GetField(rec, field, 0, 0, 0, 0, 0, 0, null_mut()) as *mut raw::cb_record_t
+        },
+        None => null_mut(),
+    }
+}
+
+/// Finds the first top-level field of a record with the given `cb_field_type_t`.
+pub(super) fn first_field_of_type(
+    rec: *mut raw::cb_record_t,
+    kind: raw::cb_field_type_t,
+) -> Option<u32> {
+    for field in 1..MAX_FIELDS {
+        let attr = attribute(rec, [field, 0, 0, 0, 0, 0, 0], TYPE_ATTRIBUTE);
+        if attr == raw::cb_field_type_t_CB_UNKNOWN_FIELD as u32 {
+            return None;
+        }
+        if attr == kind as u32 {
+            return Some(field);
+        }
+    }
+    None
+}
+
+/// A field value as read by `walk`.
+#[derive(Clone)]
+pub(super) enum FieldValue {
+    /// A single value, as many bytes as its type takes.
+    Scalar(Vec<u8>),
+    FormID(u32),
+    /// A string, without its terminator.
+    String(Vec<u8>),
+    /// The bytes of an array of fixed-size values, and the number of values.
+    Array(Vec<u8>, u32),
+    FormIDs(Vec<u32>),
+    /// An array of 32-bit values, each flagged with whether it is a FormID.
+    MixedIDs(Vec<(u32, bool)>),
+    Strings(Vec<Vec<u8>>),
+    /// A list field's length, visited before its entries.
+    List(u32),
+    /// A field the record lacks.
+    Missing,
+}
+
+/// Guards against records reporting an endless run of field identifiers.
+const MAX_FIELDS: u32 = 1024;
+
+/// Visits every readable field of a record, descending into list fields.
+///
+/// Fields are discovered through `cb_GetFieldAttribute`, so no per-game
+/// field layout is needed. Fields whose type depends on their value are
+/// read as the type CBash resolves them to. Junk, subrecord and parent
+/// record fields are skipped.
+pub(super) fn walk<F>(rec: *mut raw::cb_record_t, visit: &mut F)
+where
+    F: FnMut([u32; 7], FieldValue),
+{
+    walk_level(rec, [0; 7], 0, visit)
+}
+
+fn walk_level<F>(rec: *mut raw::cb_record_t, base: [u32; 7], slot: usize, visit: &mut F)
+where
+    F: FnMut([u32; 7], FieldValue),
+{
+    let mut path = base;
+    for field in 1..MAX_FIELDS {
+        path[slot] = field;
+        let kind = attribute(rec, path, TYPE_ATTRIBUTE);
+        if kind == raw::cb_field_type_t_CB_UNKNOWN_FIELD as u32 {
+            break;
+        }
+        if kind == raw::cb_field_type_t_CB_LIST_FIELD as u32 {
+            if slot + 2 < path.len() {
+                let len = attribute(rec, path, SIZE_ATTRIBUTE);
+                visit(path, FieldValue::List(len));
+                for index in 0..len {
+                    let mut entry = path;
+                    entry[slot + 1] = index;
+                    walk_level(rec, entry, slot + 2, visit);
+                }
+            }
+            continue;
+        }
+        if let Some(value) = read(rec, path, kind) {
+            visit(path, value);
+        }
+    }
+}
+
+fn read(rec: *mut raw::cb_record_t, path: [u32; 7], kind: u32) -> Option<FieldValue> {
+    let kind = resolve(rec, path, kind)?;
+    let value = match kind {
+        raw::cb_field_type_t_CB_FORMID_FIELD => {
+            read_scalar(rec, path, 4).map(|b| FieldValue::FormID(read_u32(&b)))
+        }
+        raw::cb_field_type_t_CB_STRING_FIELD | raw::cb_field_type_t_CB_ISTRING_FIELD => {
+            read_string(rec, path).map(FieldValue::String)
+        }
+        raw::cb_field_type_t_CB_FORMID_ARRAY_FIELD => {
+            let len = attribute(rec, path, SIZE_ATTRIBUTE) as usize;
+            Some(FieldValue::FormIDs(read_u32_array(rec, path, len)))
+        }
+        raw::cb_field_type_t_CB_UINT32_ARRAY_FIELD => {
+            let len = attribute(rec, path, SIZE_ATTRIBUTE);
+            let values = read_u32_array(rec, path, len as usize);
+            let bytes = values
+                .iter()
+                .flat_map(|v| v.to_le_bytes().to_vec())
+                .collect();
+            Some(FieldValue::Array(bytes, len))
+        }
+        raw::cb_field_type_t_CB_FORMID_OR_UINT32_ARRAY_FIELD => {
+            let len = attribute(rec, path, SIZE_ATTRIBUTE);
+            let values = read_u32_array(rec, path, len as usize);
+            let formid = raw::cb_field_type_t_CB_FORMID_FIELD as u32;
+            let values = values
+                .into_iter()
+                .zip(0..len)
+                .map(|(v, i)| (v, attribute(rec, path, VALUE_TYPE_ATTRIBUTE + i) == formid))
+                .collect();
+            Some(FieldValue::MixedIDs(values))
+        }
+        raw::cb_field_type_t_CB_STRING_ARRAY_FIELD
+        | raw::cb_field_type_t_CB_ISTRING_ARRAY_FIELD => {
+            let len = attribute(rec, path, SIZE_ATTRIBUTE) as usize;
+            Some(FieldValue::Strings(read_string_array(rec, path, len)))
+        }
+        _ => match (scalar_size(kind as u32), array_item_size(kind as u32)) {
+            (Some(size), _) => read_scalar(rec, path, size).map(FieldValue::Scalar),
+            (_, Some(size)) => {
+                let len = attribute(rec, path, SIZE_ATTRIBUTE);
+                let bytes = read_byte_array(rec, path, len as usize * size);
+                Some(FieldValue::Array(bytes, len))
+            }
+            _ => return None,
+        },
+    };
+    Some(value.unwrap_or(FieldValue::Missing))
+}
+
+/// Resolves the type of a field whose type depends on its value, or `None`
+/// for fields that cannot be read.
+fn resolve(rec: *mut raw::cb_record_t, path: [u32; 7], kind: u32) -> Option<raw::cb_field_type_t> {
+    let kind = kind as raw::cb_field_type_t;
+    match kind {
+        raw::cb_field_type_t_CB_FORMID_OR_UINT32_FIELD
+        | raw::cb_field_type_t_CB_FORMID_OR_FLOAT32_FIELD
+        | raw::cb_field_type_t_CB_UNKNOWN_OR_FORMID_OR_UINT32_FIELD
+        | raw::cb_field_type_t_CB_FORMID_OR_MGEFCODE_OR_ACTORVALUE_OR_UINT32_FIELD
+        | raw::cb_field_type_t_CB_FORMID_OR_STRING_FIELD
+        | raw::cb_field_type_t_CB_STRING_OR_FLOAT32_OR_SINT32_FIELD => {
+            let actual = attribute(rec, path, VALUE_TYPE_ATTRIBUTE) as raw::cb_field_type_t;
+            match actual {
+                raw::cb_field_type_t_CB_FORMID_FIELD
+                | raw::cb_field_type_t_CB_STRING_FIELD
+                | raw::cb_field_type_t_CB_UINT32_FIELD
+                | raw::cb_field_type_t_CB_SINT32_FIELD
+                | raw::cb_field_type_t_CB_FLOAT32_FIELD
+                | raw::cb_field_type_t_CB_MGEFCODE_FIELD
+                | raw::cb_field_type_t_CB_ACTORVALUE_FIELD => Some(actual),
+                // the value is 4 bytes either way, but a string cannot be told apart
+                _ if kind == raw::cb_field_type_t_CB_FORMID_OR_STRING_FIELD
+                    || kind == raw::cb_field_type_t_CB_STRING_OR_FLOAT32_OR_SINT32_FIELD =>
+                {
+                    None
+                }
+                _ => Some(raw::cb_field_type_t_CB_UINT32_FIELD),
+            }
+        }
+        _ => Some(kind),
+    }
+}
+
+/// Byte size of the values of the array fields CBash returns a pointer to.
+fn array_item_size(kind: u32) -> Option<usize> {
+    match kind as raw::cb_field_type_t {
+        raw::cb_field_type_t_CB_SINT8_ARRAY_FIELD | raw::cb_field_type_t_CB_UINT8_ARRAY_FIELD => {
+            Some(1)
+        }
+        raw::cb_field_type_t_CB_SINT16_ARRAY_FIELD | raw::cb_field_type_t_CB_UINT16_ARRAY_FIELD => {
+            Some(2)
+        }
+        raw::cb_field_type_t_CB_SINT32_ARRAY_FIELD
+        | raw::cb_field_type_t_CB_FLOAT32_ARRAY_FIELD
+        | raw::cb_field_type_t_CB_RADIAN_ARRAY_FIELD
+        | raw::cb_field_type_t_CB_MGEFCODE_OR_UINT32_ARRAY_FIELD => Some(4),
+        _ => None,
+    }
+}
+
+/// Writes a value read by `walk` back to a field.
+pub(super) fn write(rec: *mut raw::cb_record_t, path: [u32; 7], value: &FieldValue) {
+    match value {
+        FieldValue::Scalar(bytes) => {
+            let mut bytes = bytes.clone();
+            set_field(rec, path, bytes.as_mut_ptr() as *mut c_void, 0)
+        }
+        FieldValue::FormID(formid) => {
+            let mut formid = *formid;
+            set_field(rec, path, &mut formid as *mut u32 as *mut c_void, 0)
+        }
+        FieldValue::String(bytes) => {
+            let c_str = CString::new(bytes.clone()).unwrap().into_raw();
+            set_field(rec, path, c_str as *mut c_void, 0);
+            let _string = unsafe { CString::from_raw(c_str) };
+        }
+        FieldValue::Array(bytes, len) => {
+            let mut bytes = bytes.clone();
+            set_array(rec, path, bytes.as_mut_ptr() as *mut c_void, *len)
+        }
+        FieldValue::FormIDs(values) => {
+            let mut values = values.clone();
+            let len = values.len() as u32;
+            set_array(rec, path, values.as_mut_ptr() as *mut c_void, len)
+        }
+        FieldValue::MixedIDs(values) => {
+            let mut values: Vec<u32> = values.iter().map(|(v, _)| *v).collect();
+            let len = values.len() as u32;
+            set_array(rec, path, values.as_mut_ptr() as *mut c_void, len)
+        }
+        FieldValue::Strings(strings) => {
+            let c_strs: Vec<CString> = strings
+                .iter()
+                .map(|s| CString::new(s.clone()).unwrap())
+                .collect();
+            let mut ptrs: Vec<*const c_char> = c_strs.iter().map(|s| s.as_ptr()).collect();
+            let len = ptrs.len() as u32;
+            set_array(rec, path, ptrs.as_mut_ptr() as *mut c_void, len)
+        }
+        FieldValue::List(len) => set_field(rec, path, null_mut(), *len),
+        FieldValue::Missing => delete_field(rec, path),
+    }
+}
+
+fn set_array(rec: *mut raw::cb_record_t, path: [u32; 7], value: *mut c_void, len: u32) {
+    if len == 0 {
+        delete_field(rec, path)
+    } else {
+        set_field(rec, path, value, len)
+    }
+}
+
+fn set_field(rec: *mut raw::cb_record_t, path: [u32; 7], value: *mut c_void, len: u32) {
+    unsafe {
+        raw::cb_SetField(
+            rec, path[0], path[1], path[2], path[3], path[4], path[5], path[6], value, len,
+        )
+    }
+}
+
+fn delete_field(rec: *mut raw::cb_record_t, path: [u32; 7]) {
+    unsafe {
+        raw::cb_DeleteField(
+            rec, path[0], path[1], path[2], path[3], path[4], path[5], path[6],
+        )
+    }
+}
+
+pub(super) fn read_string(rec: *mut raw::cb_record_t, path: [u32; 7]) -> Option<Vec<u8>> {
+    unsafe {
+        let value = raw::cb_GetField(
+            rec,
+            path[0],
+            path[1],
+            path[2],
+            path[3],
+            path[4],
+            path[5],
+            path[6],
+            null_mut::<*mut c_void>(),
+        );
+        if value.is_null() {
+            return None;
+        }
+        Some(CStr::from_ptr(value as *const c_char).to_bytes().to_vec())
+    }
+}
+
+fn read_byte_array(rec: *mut raw::cb_record_t, path: [u32; 7], len: usize) -> Vec<u8> {
+    if len == 0 {
+        return Vec::new();
+    }
+    let mut data: *mut c_void = null_mut();
+    unsafe {
+        raw::cb_GetField(
+            rec, path[0], path[1], path[2], path[3], path[4], path[5], path[6], &mut data,
+        );
+        if data.is_null() {
+            return Vec::new();
+        }
+        slice::from_raw_parts(data as *const u8, len).to_vec()
+    }
+}
+
+fn read_u32_array(rec: *mut raw::cb_record_t, path: [u32; 7], len: usize) -> Vec<u32> {
+    let mut values: Vec<u32> = vec![0; len];
+    if len > 0 {
+        unsafe {
+            raw::cb_GetField(
+                rec,
+                path[0],
+                path[1],
+                path[2],
+                path[3],
+                path[4],
+                path[5],
+                path[6],
+                values.as_mut_ptr() as *mut *mut c_void,
+            );
+        }
+    }
+    values
+}
+
+fn read_string_array(rec: *mut raw::cb_record_t, path: [u32; 7], len: usize) -> Vec<Vec<u8>> {
+    let mut values: Vec<*const c_char> = vec![std::ptr::null(); len];
+    if len > 0 {
+        unsafe {
+            raw::cb_GetField(
+                rec,
+                path[0],
+                path[1],
+                path[2],
+                path[3],
+                path[4],
+                path[5],
+                path[6],
+                values.as_mut_ptr() as *mut *mut c_void,
+            );
+        }
+    }
+    values
+        .into_iter()
+        .map(|s| {
+            if s.is_null() {
+                Vec::new()
+            } else {
+                unsafe { CStr::from_ptr(s).to_bytes().to_vec() }
+            }
+        })
+        .collect()
+}
@@ -0,0 +1,236 @@
+use std::collections::HashMap;
+use std::ffi::CStr;
+use std::hash::Hasher;
+use std::mem::ManuallyDrop;
+
+use rayon::prelude::*;
+use twox_hash::XxHash64;
+
+use super::collection::{Collection, CollectionType};
+use super::fields::{self, FieldValue};
+use super::modfile::ModFile;
+use super::plugin::read_u32;
+use super::raw;
+use super::record::Record;
+
+/// A FormID keyed by the lowercased file name of the mod that defines it,
+/// so it stays stable across load orders.
+pub type LongFormID = (String, u32);
+
+pub struct FingerprintDiff {
+    pub added: Vec<LongFormID>,
+    pub removed: Vec<LongFormID>,
+    pub changed: Vec<LongFormID>,
+}
+
+/// Record header fields that change on re-saving: the version control info
+/// and, past Oblivion, the form version.
+const OBLIVION_VERSION_FIELDS: &[u32] = &[3];
+const VERSION_FIELDS: &[u32] = &[3, 5, 6];
+
+/// The record flag set on records stored compressed, which a re-save may change.
+const COMPRESSED_FLAG: u32 = 0x0004_0000;
+
+/// Resolves FormIDs to `LongFormID`s, caching the master name of each mod index.
+#[derive(Default)]
+struct Resolver {
+    masters: HashMap<u32, Vec<u8>>,
+    version_fields: Option<&'static [u32]>,
+}
+
+impl Resolver {
+    fn resolve(&mut self, rec: *mut raw::cb_record_t, formid: u32) -> (&[u8], u32) {
+        let master = self.masters.entry(formid >> 24).or_insert_with(|| unsafe {
+            let c_str = raw::cb_GetLongIDName(rec, formid, false);
+            if c_str.is_null() {
+                return Vec::new();
+            }
+            CStr::from_ptr(c_str).to_bytes().to_ascii_lowercase()
+        });
+        (master, formid & 0x00FF_FFFF)
+    }
+
+    fn long_formid(&mut self, rec: *mut raw::cb_record_t) -> LongFormID {
+        let path = [fields::FORMID_FIELD, 0, 0, 0, 0, 0, 0];
+        let formid = fields::read_scalar(rec, path, 4)
+            .map(|b| read_u32(&b))
+            .expect("Failed to read record formid.");
+        let (master, object) = self.resolve(rec, formid);
+        (String::from_utf8_lossy(master).into_owned(), object)
+    }
+
+    fn version_fields(&mut self, rec: *mut raw::cb_record_t) -> &'static [u32] {
+        self.version_fields.get_or_insert_with(|| {
+            let collection = ManuallyDrop::new(Record { raw: rec }.collection());
+            match collection.kind() {
+                CollectionType::Oblivion => OBLIVION_VERSION_FIELDS,
+                _ => VERSION_FIELDS,
+            }
+        })
+    }
+
+    /// Serializes a record's fields with master-resolved FormIDs, leaving out
+    /// what changes on re-saving: the version fields and the compressed flag.
+    fn normalize(&mut self, rec: *mut raw::cb_record_t) -> Vec<u8> {
+        let version_fields = self.version_fields(rec);
+        let mut data = Vec::new();
+        fields::walk(rec, &mut |path, value| {
+            // top-level fields have no list field identifier after their index
+            let top_level = path[2] == 0;
+            if top_level && version_fields.contains(&path[0]) {
+                return;
+            }
+            let value = match value {
+                FieldValue::Scalar(ref bytes)
+                    if top_level && path[0] == fields::FLAGS_FIELD && bytes.len() == 4 =>
+                {
+                    let flags = read_u32(bytes) & !COMPRESSED_FLAG;
+                    FieldValue::Scalar(flags.to_le_bytes().to_vec())
+                }
+                value => value,
+            };
+            for id in path.iter() {
+                data.extend_from_slice(&id.to_le_bytes());
+            }
+            match value {
+                FieldValue::Scalar(bytes)
+                | FieldValue::String(bytes)
+                | FieldValue::Array(bytes, _) => {
+                    data.push(0);
+                    data.extend_from_slice(&(bytes.len() as u32).to_le_bytes());
+                    data.extend_from_slice(&bytes);
+                }
+                FieldValue::FormID(formid) => {
+                    data.push(1);
+                    self.push_formid(&mut data, rec, formid);
+                }
+                FieldValue::FormIDs(formids) => {
+                    data.push(2);
+                    data.extend_from_slice(&(formids.len() as u32).to_le_bytes());
+                    for formid in formids {
+                        self.push_formid(&mut data, rec, formid);
+                    }
+                }
+                FieldValue::MixedIDs(values) => {
+                    data.push(3);
+                    data.extend_from_slice(&(values.len() as u32).to_le_bytes());
+                    for (value, is_formid) in values {
+                        if is_formid {
+                            data.push(1);
+                            self.push_formid(&mut data, rec, value);
+                        } else {
+                            data.push(0);
+                            data.extend_from_slice(&value.to_le_bytes());
+                        }
+                    }
+                }
+                FieldValue::Strings(strings) => {
+                    data.push(4);
+                    data.extend_from_slice(&(strings.len() as u32).to_le_bytes());
+                    for string in strings {
+                        data.extend_from_slice(&string);
+                        data.push(0);
+                    }
+                }
+                FieldValue::List(len) => {
+                    data.push(5);
+                    data.extend_from_slice(&len.to_le_bytes());
+                }
+                FieldValue::Missing => data.push(6),
+            }
+        });
+        data
+    }
+
+    fn push_formid(&mut self, data: &mut Vec<u8>, rec: *mut raw::cb_record_t, formid: u32) {
+        if formid == 0 {
+            data.push(0);
+            return;
+        }
+        let (master, object) = self.resolve(rec, formid);
+        data.extend_from_slice(master);
+        data.push(0);
+        data.extend_from_slice(&object.to_le_bytes());
+    }
+}
+
+/// Hashes the given records' normalized contents, in parallel.
+///
+/// Reading the fields goes through CBash and stays on the calling thread.
+fn fingerprint_records(records: &[Record]) -> HashMap<LongFormID, u64> {
+    let mut resolver = Resolver::default();
+    let data: Vec<(LongFormID, Vec<u8>)> = records
+        .iter()
+        .map(|r| (resolver.long_formid(r.raw), resolver.normalize(r.raw)))
+        .collect();
+    data.into_par_iter()
+        .map(|(id, bytes)| {
+            let mut hasher = XxHash64::with_seed(0);
+            hasher.write(&bytes);
+            (id, hasher.finish())
+        })
+        .collect()
+}
+
+pub(super) fn fingerprint(record: &Record) -> u64 {
+    let data = Resolver::default().normalize(record.raw);
+    let mut hasher = XxHash64::with_seed(0);
+    hasher.write(&data);
+    hasher.finish()
+}
+
+pub(super) fn mod_fingerprints(r#mod: &ModFile, rec_type: [u8; 4]) -> HashMap<LongFormID, u64> {
+    if r#mod.record_num(rec_type) <= 0 {
+        return HashMap::new();
+    }
+    fingerprint_records(&r#mod.records(rec_type))
+}
+
+/// Fingerprints the winning version of every record of `rec_type` in the load order.
+pub(super) fn collection_fingerprints(
+    collection: &Collection,
+    rec_type: [u8; 4],
+) -> HashMap<LongFormID, u64> {
+    let mut winners = Vec::new();
+    for r#mod in collection.load_order_mods() {
+        if r#mod.record_num(rec_type) <= 0 {
+            continue;
+        }
+        winners.extend(
+            r#mod
+                .records(rec_type)
+                .into_iter()
+                .filter(|r| r.is_winning(false)),
+        );
+    }
+    fingerprint_records(&winners)
+}
+
+pub(super) fn diff(old: &Collection, new: &Collection, rec_types: &[[u8; 4]]) -> FingerprintDiff {
+    let mut diff = FingerprintDiff {
+        added: Vec::new(),
+        removed: Vec::new(),
+        changed: Vec::new(),
+    };
+    for rec_type in rec_types {
+        let old_prints = collection_fingerprints(old, *rec_type);
+        let new_prints = collection_fingerprints(new, *rec_type);
+        for (id, hash) in new_prints.iter() {
+            match old_prints.get(id) {
+                Some(old_hash) if old_hash != hash => diff.changed.push(id.clone()),
+                Some(_) => {}
+                None => diff.added.push(id.clone()),
+            }
+        }
+        diff.removed.extend(
+            old_prints
+                .keys()
+                .filter(|id| !new_prints.contains_key(*id))
+                .cloned(),
+        );
+    }
+    diff.added.sort();
+    diff.removed.sort();
+    diff.changed.sort();
+    diff
+}
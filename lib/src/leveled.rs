@@ -0,0 +1,449 @@
+use std::collections::HashMap;
+use std::mem::ManuallyDrop;
+use std::path::PathBuf;
+use std::ptr::null_mut;
+
+use rayon::prelude::*;
+
+use super::fields::{self, FieldValue, TYPE_ATTRIBUTE};
+use super::modfile::ModFile;
+use super::plugin::read_header;
+use super::raw;
+use super::record::{Record, RecordFlags};
+use super::transaction;
+
+/// Field identifiers of a leveled list's entries, as passed to `Record::get_field`.
+pub struct LeveledListFields {
+    /// The list field holding the entries.
+    pub entries: u32,
+    /// The entry fields that together identify an entry, e.g. level, object and count.
+    ///
+    /// An entry's other fields, such as its owner or conditions, move along with it.
+    pub members: Vec<u32>,
+}
+
+/// An entry's member values, concatenated in the order of `LeveledListFields::members`.
+///
+/// Missing members read as zeroes, the value CBash gives new entries.
+type Entry = Vec<u8>;
+
+/// Every field of an entry, as read by `fields::walk`, so fields other than
+/// the members move along with their entry.
+type EntryFields = Vec<([u32; 7], FieldValue)>;
+
+struct Job {
+    target: Option<*mut raw::cb_record_t>,
+    winner: *mut raw::cb_record_t,
+    chain: Vec<Vec<Entry>>,
+    /// The index in `chain` of the version each version was made from.
+    parents: Vec<usize>,
+    /// The fields of each version's entries, in the same order as `chain`.
+    data: Vec<Vec<EntryFields>>,
+    /// The entries of the patch's own version, if it has one.
+    current: Option<Vec<Entry>>,
+}
+
+/// The masters of each mod, as named in its plugin header.
+struct Masters {
+    path: PathBuf,
+    names: HashMap<usize, Vec<String>>,
+}
+
+impl Masters {
+    /// Returns a mod's lowercased master names, or none if its header cannot be read.
+    fn of(&mut self, r#mod: &ModFile) -> &[String] {
+        let path = &self.path;
+        self.names.entry(r#mod.raw as usize).or_insert_with(|| {
+            read_header(&path.join(r#mod.file_name()))
+                .map(|h| h.masters.iter().map(|m| m.to_lowercase()).collect())
+                .unwrap_or_default()
+        })
+    }
+}
+
+pub(super) fn merge_leveled_lists(
+    patch: &ModFile,
+    rec_type: [u8; 4],
+    fields: &LeveledListFields,
+) -> usize {
+    let collection = ManuallyDrop::new(patch.collection());
+    let mut masters = Masters {
+        path: collection.mods_path(),
+        names: HashMap::new(),
+    };
+    let mut jobs: Vec<Job> = Vec::new();
+    for r#mod in collection.load_order_mods() {
+        if r#mod.record_num(rec_type) <= 0 {
+            continue;
+        }
+        for rec in r#mod.records(rec_type) {
+            if !rec.is_winning(false) || rec.conflict_num(false) < 2 {
+                continue;
+            }
+            if let Some(job) = collect(patch, &rec, fields, &mut masters) {
+                jobs.push(job);
+            }
+        }
+    }
+
+    // only the merge itself runs in parallel, CBash handles are not thread-safe
+    let inputs: Vec<_> = jobs
+        .iter()
+        .map(|j| (&j.chain, &j.parents, j.current.as_ref()))
+        .collect();
+    let merged: Vec<Option<Vec<Entry>>> = inputs
+        .par_iter()
+        .map(|(chain, parents, current)| merge_if_changed(chain, parents, *current))
+        .collect();
+
+    let mut written = 0;
+    for (job, entries) in jobs.iter().zip(merged) {
+        if let Some(entries) = entries {
+            let target = job
+                .target
+                .unwrap_or_else(|| copy_as_override(job.winner, patch));
+            write(target, fields, &entry_fields(job, &entries));
+            written += 1;
+        }
+    }
+    written
+}
+
+/// Reads the entries of every version of a record, oldest first, or returns
+/// `None` if no version has any.
+///
+/// The patch's own version is left out of the chain and read separately, so
+/// re-running a merge into an existing patch starts from the other versions.
+fn collect(
+    patch: &ModFile,
+    winner: &Record,
+    fields: &LeveledListFields,
+    masters: &mut Masters,
+) -> Option<Job> {
+    let mut versions: Vec<(i32, Record)> = winner
+        .conflicts(false)
+        .into_iter()
+        .map(|r| (r.r#mod().index(), r))
+        .collect();
+    versions.sort_by_key(|(i, _)| *i);
+
+    let mut target = None;
+    let mut raws = Vec::with_capacity(versions.len());
+    let mut names: Vec<String> = Vec::with_capacity(versions.len());
+    let mut parents = Vec::with_capacity(versions.len());
+    for (_, rec) in versions {
+        let r#mod = rec.r#mod();
+        if r#mod.raw == patch.raw {
+            target = Some(rec.raw);
+            continue;
+        }
+        // a version overrides the latest earlier version from one of its masters
+        let own_masters = masters.of(&r#mod);
+        let parent = (0..names.len())
+            .rev()
+            .find(|&i| own_masters.contains(&names[i]))
+            .unwrap_or(0);
+        parents.push(parent);
+        names.push(r#mod.name().to_lowercase());
+        raws.push(rec.raw);
+    }
+
+    let listed = raws
+        .iter()
+        .find(|r| fields::list_len(**r, fields.entries) > 0)?;
+    let sizes = member_sizes(*listed, fields);
+    let chain = raws
+        .iter()
+        .map(|r| read_entries(*r, fields, &sizes))
+        .collect();
+    let data = raws.iter().map(|r| read_entry_fields(*r, fields)).collect();
+    let current = target.map(|r| read_entries(r, fields, &sizes));
+    Some(Job {
+        target,
+        winner: winner.raw,
+        chain,
+        parents,
+        data,
+        current,
+    })
+}
+
+fn member_sizes(rec: *mut raw::cb_record_t, fields: &LeveledListFields) -> Vec<usize> {
+    fields
+        .members
+        .iter()
+        .map(|m| {
+            let kind = fields::attribute(rec, [fields.entries, 0, *m, 0, 0, 0, 0], TYPE_ATTRIBUTE);
+            fields::scalar_size(kind)
+                .expect("Failed to read leveled list member, not a single value.")
+        })
+        .collect()
+}
+
+fn read_entries(
+    rec: *mut raw::cb_record_t,
+    fields: &LeveledListFields,
+    sizes: &[usize],
+) -> Vec<Entry> {
+    let len = fields::list_len(rec, fields.entries);
+    (0..len)
+        .map(|index| read_entry(rec, fields, index, sizes))
+        .collect()
+}
+
+fn read_entry(
+    rec: *mut raw::cb_record_t,
+    fields: &LeveledListFields,
+    index: u32,
+    sizes: &[usize],
+) -> Entry {
+    let mut entry = Vec::with_capacity(sizes.iter().sum());
+    for (member, size) in fields.members.iter().zip(sizes) {
+        let path = [fields.entries, index, *member, 0, 0, 0, 0];
+        entry.extend(fields::read_scalar(rec, path, *size).unwrap_or_else(|| vec![0; *size]));
+    }
+    entry
+}
+
+/// Reads every field of each entry, with the entry index left as 0.
+fn read_entry_fields(rec: *mut raw::cb_record_t, fields: &LeveledListFields) -> Vec<EntryFields> {
+    let mut entries = vec![Vec::new(); fields::list_len(rec, fields.entries) as usize];
+    fields::walk(rec, &mut |mut path, value| {
+        if path[0] != fields.entries || path[2] == 0 {
+            return;
+        }
+        if let Some(entry) = entries.get_mut(path[1] as usize) {
+            path[1] = 0;
+            entry.push((path, value));
+        }
+    });
+    entries
+}
+
+/// Picks the fields of each merged entry from the latest version holding it.
+///
+/// Repeats of an entry are told apart by their order, so the second repeat
+/// comes from the latest version with at least two.
+fn entry_fields<'a>(job: &'a Job, entries: &[Entry]) -> Vec<&'a EntryFields> {
+    let mut found: HashMap<(&Entry, usize), &EntryFields> = HashMap::new();
+    for (version, data) in job.chain.iter().zip(job.data.iter()) {
+        let mut seen: HashMap<&Entry, usize> = HashMap::new();
+        for (entry, fields) in version.iter().zip(data) {
+            let nth = seen.entry(entry).or_insert(0);
+            found.insert((entry, *nth), fields);
+            *nth += 1;
+        }
+    }
+    let mut seen: HashMap<&Entry, usize> = HashMap::new();
+    entries
+        .iter()
+        .map(|entry| {
+            let nth = seen.entry(entry).or_insert(0);
+            *nth += 1;
+            found[&(entry, *nth - 1)]
+        })
+        .collect()
+}
+
+fn counts(version: &[Entry]) -> HashMap<&Entry, usize> {
+    let mut counts = HashMap::new();
+    for entry in version {
+        *counts.entry(entry).or_insert(0) += 1;
+    }
+    counts
+}
+
+/// Merges the entries of a record's versions, the first being the master's.
+///
+/// `parents` holds, for each version, the index of the earlier version it
+/// was made from, the latest one from one of its masters. An entry a version
+/// repeats fewer times than its parent is removed, down to that count, unless
+/// a later version adds it back relative to its own parent. Other entries are
+/// kept as many times as the version that repeats them most.
+fn merge(chain: &[Vec<Entry>], parents: &[usize]) -> Vec<Entry> {
+    let all_counts: Vec<HashMap<&Entry, usize>> = chain.iter().map(|v| counts(v)).collect();
+    let mut order: Vec<&Entry> = Vec::new();
+    let mut kept: HashMap<&Entry, usize> = HashMap::new();
+    let mut removed: HashMap<&Entry, usize> = HashMap::new();
+    for (i, version) in chain.iter().enumerate() {
+        let own = &all_counts[i];
+        if i > 0 {
+            let parent = &all_counts[parents[i]];
+            for (entry, parent_count) in parent.iter() {
+                let count = own.get(entry).copied().unwrap_or(0);
+                if count < *parent_count {
+                    let left = removed.entry(entry).or_insert(count);
+                    *left = (*left).min(count);
+                }
+            }
+            for (entry, count) in own.iter() {
+                if *count > parent.get(entry).copied().unwrap_or(0) {
+                    removed.remove(entry);
+                }
+            }
+        }
+        for entry in version {
+            let count = kept.entry(entry).or_insert_with(|| {
+                order.push(entry);
+                0
+            });
+            *count = (*count).max(own[entry]);
+        }
+    }
+
+    let mut merged = Vec::new();
+    for entry in order {
+        let count = removed.get(entry).copied().unwrap_or(kept[entry]);
+        for _ in 0..count {
+            merged.push(entry.clone());
+        }
+    }
+    merged
+}
+
+/// Merges a record's versions, or returns `None` if the result matches the
+/// patch's current version, or the winning version when the patch has none.
+fn merge_if_changed(
+    chain: &[Vec<Entry>],
+    parents: &[usize],
+    current: Option<&Vec<Entry>>,
+) -> Option<Vec<Entry>> {
+    let entries = merge(chain, parents);
+    if Some(&entries) == current.or_else(|| chain.last()) {
+        None
+    } else {
+        Some(entries)
+    }
+}
+
+fn copy_as_override(winner: *mut raw::cb_record_t, patch: &ModFile) -> *mut raw::cb_record_t {
+    let c_rec = unsafe {
+        raw::cb_CopyRecord(
+            winner,
+            patch.raw,
+            null_mut(),
+            0,
+            null_mut(),
+            RecordFlags::SET_AS_OVERRIDE.bits(),
+        )
+    };
+    if c_rec.is_null() {
+        panic!("Failed to copy leveled list into patch.")
+    }
+    transaction::track_created(patch.raw, c_rec);
+    c_rec
+}
+
+fn write(rec: *mut raw::cb_record_t, fields: &LeveledListFields, entries: &[&EntryFields]) {
+    transaction::track_changed(rec);
+    // resizing keeps the fields of the entries left in place, so the list starts empty
+    fields::set_list_len(rec, fields.entries, 0);
+    fields::set_list_len(rec, fields.entries, entries.len() as u32);
+    for (index, entry) in entries.iter().enumerate() {
+        for (path, value) in entry.iter() {
+            let mut path = *path;
+            path[1] = index as u32;
+            fields::write(rec, path, value);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn entries(values: &[u8]) -> Vec<Entry> {
+        values.iter().map(|v| vec![*v]).collect()
+    }
+
+    #[test]
+    fn merge_keeps_entries_added_by_every_override() {
+        let chain = vec![entries(&[1, 2]), entries(&[1, 2, 3]), entries(&[1, 2, 4])];
+        assert_eq!(merge(&chain, &[0; 3]), entries(&[1, 2, 3, 4]));
+    }
+
+    #[test]
+    fn merge_keeps_the_most_repeats_of_an_entry() {
+        let chain = vec![entries(&[1]), entries(&[1, 2, 2]), entries(&[1, 2, 2, 2])];
+        assert_eq!(merge(&chain, &[0; 3]), entries(&[1, 2, 2, 2]));
+
+        let chain = vec![entries(&[1, 1]), entries(&[1, 1, 1]), entries(&[1, 1])];
+        assert_eq!(merge(&chain, &[0; 3]), entries(&[1, 1, 1]));
+    }
+
+    #[test]
+    fn merge_drops_master_entries_an_override_removed() {
+        let chain = vec![
+            entries(&[1, 2, 3]),
+            entries(&[1, 3]),
+            entries(&[1, 2, 3, 4]),
+        ];
+        assert_eq!(merge(&chain, &[0; 3]), entries(&[1, 3, 4]));
+
+        let chain = vec![entries(&[1, 1, 2]), entries(&[1, 2]), entries(&[1, 1, 2])];
+        assert_eq!(merge(&chain, &[0; 3]), entries(&[1, 2]));
+    }
+
+    #[test]
+    fn merge_drops_entries_an_override_of_an_override_removed() {
+        let chain = vec![entries(&[1]), entries(&[1, 2]), entries(&[1])];
+        assert_eq!(merge(&chain, &[0, 0, 1]), entries(&[1]));
+        // without the adding mod as a master, the entry was never seen
+        assert_eq!(merge(&chain, &[0, 0, 0]), entries(&[1, 2]));
+
+        let chain = vec![entries(&[1]), entries(&[1, 2, 2]), entries(&[1, 2])];
+        assert_eq!(merge(&chain, &[0, 0, 1]), entries(&[1, 2]));
+    }
+
+    #[test]
+    fn merge_keeps_entries_added_back_by_a_later_override() {
+        let chain = vec![entries(&[1, 2]), entries(&[1]), entries(&[1, 2, 3])];
+        assert_eq!(merge(&chain, &[0, 0, 1]), entries(&[1, 2, 3]));
+        assert_eq!(merge(&chain, &[0, 0, 0]), entries(&[1, 3]));
+    }
+
+    #[test]
+    fn entry_fields_come_from_the_latest_version_holding_the_entry() {
+        let field = |value: u8| vec![([1, 0, 2, 0, 0, 0, 0], FieldValue::Scalar(vec![value]))];
+        let job = Job {
+            target: None,
+            winner: null_mut(),
+            chain: vec![entries(&[1, 2]), entries(&[1, 2, 2]), entries(&[1])],
+            parents: vec![0; 3],
+            data: vec![
+                vec![field(10), field(20)],
+                vec![field(11), field(21), field(22)],
+                vec![field(12)],
+            ],
+            current: None,
+        };
+        let picked: Vec<u8> = entry_fields(&job, &entries(&[1, 2, 2]))
+            .into_iter()
+            .map(|f| match &f[0].1 {
+                FieldValue::Scalar(value) => value[0],
+                _ => 0,
+            })
+            .collect();
+        assert_eq!(picked, vec![12, 21, 22]);
+    }
+
+    #[test]
+    fn merge_skips_unchanged_lists() {
+        let chain = vec![entries(&[1, 2]), entries(&[1, 2, 3])];
+        assert_eq!(merge_if_changed(&chain, &[0; 2], None), None);
+
+        let chain = vec![entries(&[1]), entries(&[1, 2]), entries(&[1, 3])];
+        assert_eq!(
+            merge_if_changed(&chain, &[0; 3], None),
+            Some(entries(&[1, 2, 3]))
+        );
+        assert_eq!(
+            merge_if_changed(&chain, &[0; 3], Some(&entries(&[1, 2, 3]))),
+            None
+        );
+        assert_eq!(
+            merge_if_changed(&chain, &[0; 3], Some(&entries(&[1, 2]))),
+            Some(entries(&[1, 2, 3]))
+        );
+    }
+}
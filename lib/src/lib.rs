@@ -1,15 +1,31 @@
 mod collection;
+mod fields;
+mod fingerprint;
+mod leveled;
 mod modfile;
+mod plugin;
 mod raw;
 mod record;
+mod spatial;
+mod strings;
+mod transaction;
+mod types;
+mod validate;
 
 use std::collections::HashMap;
 use std::convert::TryInto;
 use std::ptr::null_mut;
 
 pub use collection::{Collection, CollectionType};
+pub use fingerprint::{FingerprintDiff, LongFormID};
+pub use leveled::LeveledListFields;
 pub use modfile::{ModFile, ModFlags, RecordOption};
+pub use plugin::{scan_plugin_headers, top_level_groups, PluginHeader};
 pub use record::{Record, RecordFlags};
+pub use spatial::{SpatialFields, SpatialIndex, CELL_SIZE};
+pub use strings::{StringKind, StringTables};
+pub use transaction::Transaction;
+pub use validate::{InvalidReason, InvalidReference, ValidationReport};
 
 pub mod prelude {
     pub use super::RecordOption::*;
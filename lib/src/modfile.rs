@@ -1,14 +1,22 @@
 use std::collections::HashMap;
 use std::convert::TryInto;
 use std::ffi::{CStr, CString};
+use std::mem::ManuallyDrop;
 use std::ptr::null_mut;
 use std::str::from_utf8;
 
 use bitflags::bitflags;
 
 use super::collection::Collection;
+use super::fields;
+use super::fingerprint::{self, LongFormID};
+use super::leveled::{self, LeveledListFields};
+use super::plugin::{read_u32, LOCALIZED_FLAG};
 use super::raw;
 use super::record::{Record, RecordFlags};
+use super::strings::StringTables;
+use super::transaction::{self, Transaction};
+use super::types;
 
 bitflags! {
     pub struct ModFlags: i32 {
@@ -77,14 +85,14 @@ impl ModFile {
 
     pub fn record_types(&self) -> Vec<String> {
         let num = self.record_type_num();
-        let mut recs: Vec<u32> = Vec::with_capacity(num.try_into().unwrap());
+        let mut recs: Vec<u32> = vec![0; num.try_into().unwrap()];
         unsafe {
             if raw::cb_GetModTypes(self.raw, recs.as_mut_ptr()).is_negative() {
                 panic!("Failed to get record types in mod.")
             }
         }
         recs.iter_mut()
-            .map(|i| from_utf8(&i.to_be_bytes()).unwrap().to_string()) // TODO ensure endianness
+            .map(|i| from_utf8(&i.to_le_bytes()).unwrap().to_string())
             .collect()
     }
 
@@ -157,6 +165,7 @@ impl ModFile {
     }
 
     pub fn update_references(&self, formid_map: &HashMap<u32, u32>) -> Vec<u32> {
+        transaction::track_all(self);
         super::update_references(Some(self), None, formid_map)
     }
 
@@ -192,7 +201,7 @@ impl ModFile {
         parent: &Record,
         flags: RecordFlags,
     ) -> Record {
-        let rec_type = u32::from_be_bytes(rec_type); // TODO check endianness
+        let rec_type = u32::from_le_bytes(rec_type);
         let c_edid = CString::new(rec_edid).unwrap().into_raw();
         let c_flags = flags.bits();
         let c_rec = unsafe {
@@ -204,11 +213,12 @@ impl ModFile {
             let _string = CString::from_raw(c_edid);
             c_rec
         };
+        transaction::track_created(self.raw, c_rec);
         Record { raw: c_rec }
     }
 
     pub fn record_num(&self, rec_type: [u8; 4]) -> i32 {
-        let rec_type = u32::from_be_bytes(rec_type); // TODO check endianness
+        let rec_type = u32::from_le_bytes(rec_type);
         let num = unsafe { raw::cb_GetNumRecords(self.raw, rec_type) };
         if num.is_negative() {
             panic!("Failed to get number of records of type ???")
@@ -218,14 +228,30 @@ impl ModFile {
 
     pub fn records(&self, rec_type: [u8; 4]) -> Vec<Record> {
         let num = self.record_num(rec_type);
-        let rec_type = u32::from_be_bytes(rec_type); // TODO check endianness
-        let mut recs: Vec<raw::cb_record_t> = Vec::with_capacity(num.try_into().unwrap());
+        let rec_type = u32::from_le_bytes(rec_type);
+        let mut recs: Vec<*mut raw::cb_record_t> = vec![null_mut(); num.try_into().unwrap()];
         unsafe {
-            if raw::cb_GetRecordIDs(self.raw, rec_type, &mut recs.as_mut_ptr()).is_negative() {
+            if raw::cb_GetRecordIDs(self.raw, rec_type, recs.as_mut_ptr()).is_negative() {
                 panic!("Failed to get records of type ???")
             }
         }
-        recs.iter_mut().map(|r| Record { raw: r }).collect()
+        recs.into_iter().map(|raw| Record { raw }).collect()
+    }
+
+    /// Lists the record types this mod holds records of, out of every type its game has.
+    ///
+    /// Unlike `record_types`, this does not need the mod to be loaded with
+    /// `ModFlags::TRACK_NEW_TYPES` and includes the types of overrides.
+    pub(super) fn present_types(&self) -> Vec<[u8; 4]> {
+        let kind = ManuallyDrop::new(self.collection()).kind();
+        types::record_types(kind)
+            .into_iter()
+            .filter(|t| unsafe { raw::cb_GetNumRecords(self.raw, u32::from_le_bytes(*t)) } > 0)
+            .collect()
+    }
+
+    pub fn fingerprints(&self, rec_type: [u8; 4]) -> HashMap<LongFormID, u64> {
+        fingerprint::mod_fingerprints(self, rec_type)
     }
 
     pub fn save(&self, name: &str) {
@@ -249,6 +275,37 @@ impl ModFile {
         Collection { raw: c_col }
     }
 
+    /// Merges the leveled lists of `rec_type` across their override chains into this mod.
+    ///
+    /// Returns the number of lists written, lists whose winning version already
+    /// matches the merge are left out.
+    pub fn merge_leveled_lists(&self, rec_type: [u8; 4], fields: &LeveledListFields) -> usize {
+        leveled::merge_leveled_lists(self, rec_type, fields)
+    }
+
+    /// Opens the string tables of a localized plugin, from the `Strings`
+    /// folder of the collection's data directory.
+    ///
+    /// Returns `None` if the plugin stores its strings inline.
+    pub fn string_tables(&self, language: &str) -> Option<StringTables> {
+        let header = unsafe { raw::cb_GetRecordID(self.raw, 0, null_mut()) };
+        if header.is_null() {
+            panic!("Failed to get mod header.")
+        }
+        let flags = fields::read_scalar(header, [fields::FLAGS_FIELD, 0, 0, 0, 0, 0, 0], 4)
+            .map(|b| read_u32(&b))?;
+        if flags & LOCALIZED_FLAG == 0 {
+            return None;
+        }
+        let path = ManuallyDrop::new(self.collection()).mods_path();
+        let path = path.to_str().expect("Failed to parse mods path.");
+        Some(StringTables::new(path, self.name(), language))
+    }
+
+    pub fn begin_transaction(&self) -> Transaction {
+        Transaction::begin(self.raw)
+    }
+
     pub fn load(&self) {
         unsafe {
             if raw::cb_LoadMod(self.raw).is_negative() {
@@ -0,0 +1,352 @@
+use std::convert::TryInto;
+use std::fs::{self, File};
+use std::io::{self, Read, Seek, SeekFrom};
+use std::path::Path;
+
+use rayon::prelude::*;
+
+const PLUGIN_EXTENSIONS: [&str; 3] = ["esm", "esp", "esl"];
+
+/// Record header size for Oblivion; every later game adds 4 bytes of version info.
+const OBLIVION_HEADER_SIZE: usize = 20;
+const HEADER_SIZE: usize = 24;
+
+/// Header flag of plugins whose strings live in separate string files.
+pub(super) const LOCALIZED_FLAG: u32 = 0x0000_0080;
+
+pub struct PluginHeader {
+    pub file_name: String,
+    pub flags: u32,
+    pub version: f32,
+    pub record_num: u32,
+    pub next_object_id: u32,
+    pub author: String,
+    pub description: String,
+    pub masters: Vec<String>,
+}
+
+impl PluginHeader {
+    pub fn is_master(&self) -> bool {
+        self.flags & 0x0000_0001 != 0
+    }
+
+    pub fn is_localized(&self) -> bool {
+        self.flags & LOCALIZED_FLAG != 0
+    }
+
+    pub fn is_light(&self) -> bool {
+        self.flags & 0x0000_0200 != 0
+    }
+}
+
+/// Reads the TES4 record of every plugin in `path` without creating a collection.
+///
+/// Only the header record is read from each file, and files are read in parallel.
+/// Files whose header cannot be read are left out and their names returned
+/// alongside the headers.
+pub fn scan_plugin_headers(path: &str) -> (Vec<PluginHeader>, Vec<String>) {
+    let entries = fs::read_dir(path).expect("Failed to read plugin directory.");
+    let mut files: Vec<_> = entries
+        .filter_map(|e| e.ok().map(|e| e.path()))
+        .filter(|p| p.is_file() && is_plugin(p))
+        .collect();
+    files.sort();
+    let results: Vec<io::Result<PluginHeader>> = files.par_iter().map(|p| read_header(p)).collect();
+    let mut headers = Vec::with_capacity(results.len());
+    let mut skipped = Vec::new();
+    for (file, result) in files.iter().zip(results) {
+        match result {
+            Ok(header) => headers.push(header),
+            Err(_) => skipped.push(file_name(file)),
+        }
+    }
+    (headers, skipped)
+}
+
+/// Lists the record types of the top-level groups in a plugin.
+///
+/// Groups are skipped by their header size, so none of their records are read.
+pub fn top_level_groups(path: &str) -> Vec<[u8; 4]> {
+    let mut file = File::open(path).expect("Failed to open plugin.");
+    let len = file
+        .metadata()
+        .expect("Failed to read plugin metadata.")
+        .len();
+    read_groups(&mut file, len).expect("Failed to read plugin groups.")
+}
+
+fn is_plugin(path: &Path) -> bool {
+    match path.extension().and_then(|e| e.to_str()) {
+        Some(ext) => PLUGIN_EXTENSIONS
+            .iter()
+            .any(|p| p.eq_ignore_ascii_case(ext)),
+        None => false,
+    }
+}
+
+pub(super) fn read_header(path: &Path) -> io::Result<PluginHeader> {
+    let mut file = File::open(path)?;
+    let len = file.metadata()?.len();
+    parse_header(&mut file, len, file_name(path))
+}
+
+/// Parses the TES4 record at the start of `reader`, which holds `len` bytes.
+fn parse_header<R: Read>(reader: &mut R, len: u64, file_name: String) -> io::Result<PluginHeader> {
+    let mut head = [0_u8; HEADER_SIZE];
+    reader.read_exact(&mut head)?;
+    if &head[..4] != b"TES4" {
+        return Err(io::Error::new(io::ErrorKind::InvalidData, "not a plugin"));
+    }
+    let data_size = read_u32(&head[4..]) as usize;
+    let flags = read_u32(&head[8..]);
+    // a corrupt size would otherwise allocate up to 4 GiB before the read fails
+    if (header_size(&head) + data_size) as u64 > len {
+        return Err(io::Error::new(
+            io::ErrorKind::InvalidData,
+            "header larger than file",
+        ));
+    }
+
+    // Oblivion's header is 4 bytes shorter, so its first subrecord
+    // already sits in the last 4 bytes we read.
+    let mut data: Vec<u8> = Vec::with_capacity(data_size);
+    if header_size(&head) == OBLIVION_HEADER_SIZE {
+        data.extend_from_slice(&head[OBLIVION_HEADER_SIZE..]);
+        if data_size > data.len() {
+            data.resize(data_size, 0);
+            reader.read_exact(&mut data[HEADER_SIZE - OBLIVION_HEADER_SIZE..])?;
+        } else {
+            data.truncate(data_size);
+        }
+    } else {
+        data.resize(data_size, 0);
+        reader.read_exact(&mut data)?;
+    }
+
+    let mut header = PluginHeader {
+        file_name,
+        flags,
+        version: 0.0,
+        record_num: 0,
+        next_object_id: 0,
+        author: String::new(),
+        description: String::new(),
+        masters: Vec::new(),
+    };
+    for (sig, body) in subrecords(&data) {
+        match sig {
+            b"HEDR" if body.len() >= 12 => {
+                header.version = f32::from_bits(read_u32(body));
+                header.record_num = read_u32(&body[4..]);
+                header.next_object_id = read_u32(&body[8..]);
+            }
+            b"CNAM" => header.author = read_zstring(body),
+            b"SNAM" => header.description = read_zstring(body),
+            b"MAST" => header.masters.push(read_zstring(body)),
+            _ => {}
+        }
+    }
+    Ok(header)
+}
+
+/// Reads the group types of a plugin held in `reader`, which holds `len` bytes.
+fn read_groups<R: Read + Seek>(reader: &mut R, len: u64) -> io::Result<Vec<[u8; 4]>> {
+    let mut head = [0_u8; HEADER_SIZE];
+    reader.read_exact(&mut head)?;
+    if &head[..4] != b"TES4" {
+        return Err(io::Error::new(io::ErrorKind::InvalidData, "not a plugin"));
+    }
+    let header_size = header_size(&head) as u64;
+    let mut pos = header_size + u64::from(read_u32(&head[4..]));
+    let mut groups = Vec::new();
+    while pos + 12 <= len {
+        let mut group = [0_u8; 12];
+        reader.seek(SeekFrom::Start(pos))?;
+        reader.read_exact(&mut group)?;
+        let size = u64::from(read_u32(&group[4..]));
+        if &group[..4] != b"GRUP" || size < header_size {
+            return Err(io::Error::new(io::ErrorKind::InvalidData, "bad group"));
+        }
+        groups.push([group[8], group[9], group[10], group[11]]);
+        pos += size;
+    }
+    Ok(groups)
+}
+
+fn file_name(path: &Path) -> String {
+    path.file_name()
+        .map(|n| n.to_string_lossy().into_owned())
+        .unwrap_or_default()
+}
+
+fn header_size(head: &[u8; HEADER_SIZE]) -> usize {
+    if &head[OBLIVION_HEADER_SIZE..] == b"HEDR" {
+        OBLIVION_HEADER_SIZE
+    } else {
+        HEADER_SIZE
+    }
+}
+
+/// Splits record data into `(signature, body)` pairs, honouring `XXXX` size overrides.
+pub(super) fn subrecords(data: &[u8]) -> Vec<(&[u8], &[u8])> {
+    let mut subs = Vec::new();
+    let mut pos = 0;
+    let mut next_size: Option<usize> = None;
+    while pos + 6 <= data.len() {
+        let sig = &data[pos..pos + 4];
+        let size = next_size
+            .take()
+            .unwrap_or_else(|| u16::from_le_bytes([data[pos + 4], data[pos + 5]]) as usize);
+        pos += 6;
+        if pos + size > data.len() {
+            break;
+        }
+        let body = &data[pos..pos + size];
+        pos += size;
+        if sig == b"XXXX" && size == 4 {
+            next_size = Some(read_u32(body) as usize);
+        } else {
+            subs.push((sig, body));
+        }
+    }
+    subs
+}
+
+pub(super) fn read_u32(bytes: &[u8]) -> u32 {
+    u32::from_le_bytes(bytes[..4].try_into().unwrap())
+}
+
+fn read_zstring(bytes: &[u8]) -> String {
+    let end = bytes.iter().position(|&b| b == 0).unwrap_or(bytes.len());
+    String::from_utf8_lossy(&bytes[..end]).into_owned()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::io::Cursor;
+
+    fn subrecord(sig: &[u8; 4], body: &[u8]) -> Vec<u8> {
+        let mut data = sig.to_vec();
+        data.extend_from_slice(&(body.len() as u16).to_le_bytes());
+        data.extend_from_slice(body);
+        data
+    }
+
+    fn record_header(sig: &[u8; 4], size: u32, flags: u32, header_size: usize) -> Vec<u8> {
+        let mut data = sig.to_vec();
+        data.extend_from_slice(&size.to_le_bytes());
+        data.extend_from_slice(&flags.to_le_bytes());
+        data.resize(header_size, 0);
+        data
+    }
+
+    /// Builds a plugin from its TES4 subrecords and the labels of its empty groups.
+    fn plugin(header_size: usize, flags: u32, subs: &[Vec<u8>], groups: &[&[u8; 4]]) -> Vec<u8> {
+        let data = subs.concat();
+        let mut file = record_header(b"TES4", data.len() as u32, flags, header_size);
+        file.extend_from_slice(&data);
+        for label in groups {
+            let mut group = record_header(b"GRUP", header_size as u32, 0, header_size);
+            group[8..12].copy_from_slice(*label);
+            file.extend_from_slice(&group);
+        }
+        file
+    }
+
+    fn hedr() -> Vec<u8> {
+        let mut body = 1.7_f32.to_bits().to_le_bytes().to_vec();
+        body.extend_from_slice(&12_u32.to_le_bytes());
+        body.extend_from_slice(&0x800_u32.to_le_bytes());
+        subrecord(b"HEDR", &body)
+    }
+
+    fn parse(file: &[u8]) -> io::Result<PluginHeader> {
+        parse_header(
+            &mut Cursor::new(file),
+            file.len() as u64,
+            "Test.esp".to_string(),
+        )
+    }
+
+    fn error_kind(file: &[u8]) -> Option<io::ErrorKind> {
+        parse(file).err().map(|e| e.kind())
+    }
+
+    #[test]
+    fn parse_header_reads_subrecords() {
+        let subs = [
+            hedr(),
+            subrecord(b"CNAM", b"Author\0"),
+            subrecord(b"SNAM", b"Description\0"),
+            subrecord(b"MAST", b"Skyrim.esm\0"),
+            subrecord(b"DATA", &[0; 8]),
+            subrecord(b"MAST", b"Update.esm\0"),
+            subrecord(b"DATA", &[0; 8]),
+        ];
+        let header = parse(&plugin(HEADER_SIZE, 0x81, &subs, &[])).unwrap();
+        assert_eq!(header.file_name, "Test.esp");
+        assert!(header.is_master() && header.is_localized() && !header.is_light());
+        assert_eq!(header.version, 1.7);
+        assert_eq!(header.record_num, 12);
+        assert_eq!(header.next_object_id, 0x800);
+        assert_eq!(header.author, "Author");
+        assert_eq!(header.description, "Description");
+        assert_eq!(header.masters, vec!["Skyrim.esm", "Update.esm"]);
+    }
+
+    #[test]
+    fn parse_header_reads_oblivion_headers() {
+        let subs = [hedr(), subrecord(b"MAST", b"Oblivion.esm\0")];
+        let header = parse(&plugin(OBLIVION_HEADER_SIZE, 0, &subs, &[b"GMST"])).unwrap();
+        assert_eq!(header.record_num, 12);
+        assert_eq!(header.masters, vec!["Oblivion.esm"]);
+    }
+
+    #[test]
+    fn parse_header_rejects_bad_files() {
+        let mut file = plugin(HEADER_SIZE, 0, &[hedr()], &[]);
+        assert_eq!(
+            error_kind(&file[..HEADER_SIZE - 1]),
+            Some(io::ErrorKind::UnexpectedEof)
+        );
+
+        // a data size past the end of the file is rejected before reading
+        file[4..8].copy_from_slice(&u32::max_value().to_le_bytes());
+        assert_eq!(error_kind(&file), Some(io::ErrorKind::InvalidData));
+
+        file[..4].copy_from_slice(b"TES3");
+        assert_eq!(error_kind(&file), Some(io::ErrorKind::InvalidData));
+    }
+
+    #[test]
+    fn subrecords_honour_size_overrides() {
+        let long = vec![7_u8; 0x1_0010];
+        let mut data = subrecord(b"XXXX", &(long.len() as u32).to_le_bytes());
+        data.extend_from_slice(b"DATA\0\0");
+        data.extend_from_slice(&long);
+        data.extend(subrecord(b"EDID", b"Test\0"));
+        // a truncated subrecord ends the list
+        data.extend_from_slice(b"FULL\x10\0abc");
+
+        let subs = subrecords(&data);
+        assert_eq!(subs.len(), 2);
+        assert_eq!(subs[0], (&b"DATA"[..], &long[..]));
+        assert_eq!(subs[1], (&b"EDID"[..], &b"Test\0"[..]));
+    }
+
+    #[test]
+    fn read_groups_skips_group_contents() {
+        for header_size in [OBLIVION_HEADER_SIZE, HEADER_SIZE].iter() {
+            let file = plugin(*header_size, 0, &[hedr()], &[b"GMST", b"WEAP"]);
+            let groups = read_groups(&mut Cursor::new(&file), file.len() as u64).unwrap();
+            assert_eq!(groups, vec![*b"GMST", *b"WEAP"]);
+        }
+
+        let mut file = plugin(HEADER_SIZE, 0, &[hedr()], &[b"GMST"]);
+        let group = file.len() - HEADER_SIZE;
+        file[group..group + 4].copy_from_slice(b"GRUQ");
+        let len = file.len() as u64;
+        assert!(read_groups(&mut Cursor::new(&file), len).is_err());
+    }
+}
@@ -7,8 +7,10 @@ use std::slice;
 use bitflags::bitflags;
 
 use super::collection::Collection;
+use super::fingerprint;
 use super::modfile::ModFile;
 use super::raw;
+use super::transaction;
 
 bitflags! {
     pub struct RecordFlags: i32 {
@@ -80,26 +82,30 @@ impl Record {
 
     pub fn conflicts(&self, extended_conflicts: bool) -> Vec<Record> {
         let num = self.conflict_num(extended_conflicts);
-        let mut recs: Vec<raw::cb_record_t> = Vec::with_capacity(num.try_into().unwrap());
-        unsafe {
-            if raw::cb_GetRecordConflicts(self.raw, &mut recs.as_mut_ptr(), extended_conflicts)
-                .is_negative()
-            {
-                panic!("Failed to get conflicting records.")
-            }
+        let mut recs: Vec<*mut raw::cb_record_t> = vec![null_mut(); num.try_into().unwrap()];
+        let got =
+            unsafe { raw::cb_GetRecordConflicts(self.raw, recs.as_mut_ptr(), extended_conflicts) };
+        if got.is_negative() {
+            panic!("Failed to get conflicting records.")
         }
-        recs.iter_mut().map(|r| Record { raw: r }).collect()
+        recs.truncate(got.try_into().unwrap());
+        recs.into_iter().map(|raw| Record { raw }).collect()
     }
 
     pub fn history(&self) -> Vec<Record> {
         let num = self.conflict_num(false); // TODO check correctness
-        let mut recs: Vec<raw::cb_record_t> = Vec::with_capacity(num.try_into().unwrap());
-        unsafe {
-            if raw::cb_GetRecordHistory(self.raw, &mut recs.as_mut_ptr()).is_negative() {
-                panic!("Failed to get conflicting records.")
-            }
+        let mut recs: Vec<*mut raw::cb_record_t> = vec![null_mut(); num.try_into().unwrap()];
+        let got = unsafe { raw::cb_GetRecordHistory(self.raw, recs.as_mut_ptr()) };
+        if got.is_negative() {
+            panic!("Failed to get conflicting records.")
         }
-        recs.iter_mut().map(|r| Record { raw: r }).collect()
+        recs.truncate(got.try_into().unwrap());
+        recs.into_iter().map(|raw| Record { raw }).collect()
+    }
+
+    /// Hash of the record's contents, with FormIDs resolved to their masters.
+    pub fn fingerprint(&self) -> u64 {
+        fingerprint::fingerprint(self)
     }
 
     pub fn copy_into(
@@ -121,14 +127,17 @@ impl Record {
             let _string = CString::from_raw(c_edid);
             c_rec
         };
+        transaction::track_created(dest.raw, c_rec);
         Record { raw: c_rec }
     }
 
     pub fn update_references(&self, formid_map: &HashMap<u32, u32>) -> Vec<u32> {
+        transaction::track_changed(self.raw);
         super::update_references(None, Some(self), formid_map)
     }
 
     pub fn reset(&self) {
+        transaction::track_changed(self.raw);
         unsafe {
             if raw::cb_ResetRecord(self.raw).is_positive() {
                 panic!("Failed to reset record.")
@@ -137,6 +146,7 @@ impl Record {
     }
 
     pub fn set_id(&self, formid: u32, edid: &str) {
+        transaction::track_changed(self.raw);
         let c_edid = CString::new(edid).unwrap().into_raw();
         unsafe {
             raw::cb_SetIDFields(self.raw, formid, c_edid);
@@ -205,6 +215,7 @@ impl Record {
         // TODO this void cast is suspicious
         let mut value: Vec<u8> = Vec::with_capacity(length);
         let c_value = value.as_mut_ptr() as *mut c_void;
+        transaction::track_changed(self.raw);
         unsafe {
             raw::cb_SetField(
                 self.raw,
@@ -223,6 +234,7 @@ impl Record {
     }
 
     pub fn delete_field(&self, fields: [u32; 7]) {
+        transaction::track_changed(self.raw);
         unsafe {
             raw::cb_DeleteField(
                 self.raw, fields[0], fields[1], fields[2], fields[3], fields[4], fields[5],
@@ -241,8 +253,9 @@ impl Record {
 
     // not included in drop since I dunno if it should be auto-deleted
     pub fn delete(&self) {
+        transaction::track_deleted(self.raw);
         unsafe {
-            if raw::cb_DeleteRecord(self.raw).is_positive() {
+            if raw::cb_DeleteRecord(self.raw) == 0 {
                 panic!("Failed to delete record.")
             }
         }
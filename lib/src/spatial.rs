@@ -0,0 +1,312 @@
+use std::collections::HashMap;
+use std::ptr::null_mut;
+
+use super::collection::{Collection, CollectionType};
+use super::fields;
+use super::plugin::read_u32;
+use super::raw;
+use super::record::Record;
+
+/// Width of an exterior cell in game units.
+pub const CELL_SIZE: f32 = 4096.0;
+
+/// Field identifiers of a placed reference's position and of a cell's grid
+/// coordinates, as passed to `Record::get_field`.
+pub struct SpatialFields {
+    pub pos_x: [u32; 7],
+    pub pos_y: [u32; 7],
+    pub pos_z: [u32; 7],
+    pub cell_x: [u32; 7],
+    pub cell_y: [u32; 7],
+}
+
+#[derive(Default)]
+struct GridCell {
+    cell: Option<*mut raw::cb_record_t>,
+    land: Option<*mut raw::cb_record_t>,
+    refs: Vec<usize>,
+}
+
+#[derive(Default)]
+struct Space {
+    cells: HashMap<(i32, i32), GridCell>,
+    min: (i32, i32),
+    max: (i32, i32),
+}
+
+impl Space {
+    fn square(&mut self, key: (i32, i32)) -> &mut GridCell {
+        if self.cells.is_empty() {
+            self.min = key;
+            self.max = key;
+        } else {
+            self.min = (self.min.0.min(key.0), self.min.1.min(key.1));
+            self.max = (self.max.0.max(key.0), self.max.1.max(key.1));
+        }
+        self.cells.entry(key).or_default()
+    }
+
+    /// Returns the populated squares within the given inclusive bounds.
+    ///
+    /// The bounds are clamped to the populated area first, and the map is
+    /// scanned instead when that area still holds more squares than the map.
+    fn squares(&self, min: (i32, i32), max: (i32, i32)) -> Vec<&GridCell> {
+        let min = (min.0.max(self.min.0), min.1.max(self.min.1));
+        let max = (max.0.min(self.max.0), max.1.min(self.max.1));
+        if self.cells.is_empty() || min.0 > max.0 || min.1 > max.1 {
+            return Vec::new();
+        }
+        let area =
+            (i64::from(max.0) - i64::from(min.0) + 1) * (i64::from(max.1) - i64::from(min.1) + 1);
+        if area > self.cells.len() as i64 {
+            let mut found: Vec<(&(i32, i32), &GridCell)> = self
+                .cells
+                .iter()
+                .filter(|((x, y), _)| *x >= min.0 && *x <= max.0 && *y >= min.1 && *y <= max.1)
+                .collect();
+            found.sort_by_key(|(k, _)| **k);
+            return found.into_iter().map(|(_, c)| c).collect();
+        }
+        let mut found = Vec::new();
+        for x in min.0..=max.0 {
+            for y in min.1..=max.1 {
+                if let Some(c) = self.cells.get(&(x, y)) {
+                    found.push(c);
+                }
+            }
+        }
+        found
+    }
+}
+
+/// Cell grid over the winning cells, landscapes and placed references of a collection.
+///
+/// Everything is grouped per worldspace and bucketed by grid cell. Spaces are
+/// keyed by the FormID of their `WRLD`, so the overrides every mod holds of a
+/// worldspace share one grid. Interior cells have no worldspace, so each one
+/// gets a grid of its own and queries take the `CELL` record in place of the
+/// `WRLD`. Any version of the `WRLD` or `CELL` record can be passed.
+pub struct SpatialIndex {
+    spaces: HashMap<u32, Space>,
+    refs: Vec<*mut raw::cb_record_t>,
+    positions: Vec<[f32; 3]>,
+    ids: HashMap<usize, usize>,
+}
+
+impl SpatialIndex {
+    pub fn new(collection: &Collection, fields: &SpatialFields) -> SpatialIndex {
+        let mut index = SpatialIndex {
+            spaces: HashMap::new(),
+            refs: Vec::new(),
+            positions: Vec::new(),
+            ids: HashMap::new(),
+        };
+        let mods = collection.load_order_mods();
+        for r#mod in mods.iter() {
+            if r#mod.record_num(*b"CELL") <= 0 {
+                continue;
+            }
+            let cells = r#mod.records(*b"CELL");
+            let parent_field = cells.first().and_then(parent_field);
+            for cell in cells.iter().filter(|r| r.is_winning(false)) {
+                let wrld = parent_field.map_or(null_mut(), |f| parent(cell.raw, f));
+                if wrld.is_null() {
+                    continue;
+                }
+                let x = fields::read_scalar(cell.raw, fields.cell_x, 4);
+                let y = fields::read_scalar(cell.raw, fields.cell_y, 4);
+                if let (Some(x), Some(y)) = (x, y) {
+                    let key = (read_u32(&x) as i32, read_u32(&y) as i32);
+                    index.space(formid(wrld)).square(key).cell = Some(cell.raw);
+                }
+            }
+        }
+
+        let mut cell_spaces: HashMap<u32, (u32, Option<(i32, i32)>)> = HashMap::new();
+        let types: &[[u8; 4]] = match collection.kind() {
+            CollectionType::Skyrim => &[*b"LAND", *b"REFR", *b"ACHR"],
+            _ => &[*b"LAND", *b"REFR", *b"ACHR", *b"ACRE"],
+        };
+        for r#mod in mods.iter() {
+            for rec_type in types {
+                if r#mod.record_num(*rec_type) <= 0 {
+                    continue;
+                }
+                let recs = r#mod.records(*rec_type);
+                let parent_field = recs.first().and_then(parent_field);
+                for rec in recs.iter().filter(|r| r.is_winning(false)) {
+                    let cell = parent_field.map_or(null_mut(), |f| parent(rec.raw, f));
+                    let (space, grid) = if cell.is_null() {
+                        (0, None)
+                    } else {
+                        *cell_spaces
+                            .entry(formid(cell))
+                            .or_insert_with(|| cell_space(cell, fields))
+                    };
+                    if rec_type == b"LAND" {
+                        if let Some(key) = grid {
+                            index.space(space).square(key).land = Some(rec.raw);
+                        }
+                    } else {
+                        index.insert(rec, fields, space);
+                    }
+                }
+            }
+        }
+        index
+    }
+
+    fn space(&mut self, space: u32) -> &mut Space {
+        self.spaces.entry(space).or_default()
+    }
+
+    /// Indexes a reference by its position, skipping references that have none.
+    fn insert(&mut self, rec: &Record, fields: &SpatialFields, space: u32) {
+        let pos = match (
+            read_f32(rec.raw, fields.pos_x),
+            read_f32(rec.raw, fields.pos_y),
+            read_f32(rec.raw, fields.pos_z),
+        ) {
+            (Some(x), Some(y), Some(z)) => [x, y, z],
+            _ => return,
+        };
+        let key = (grid_coord(pos[0]), grid_coord(pos[1]));
+        let id = self.refs.len();
+        self.refs.push(rec.raw);
+        self.positions.push(pos);
+        self.ids.insert(rec.raw as usize, id);
+        self.space(space).square(key).refs.push(id);
+    }
+
+    pub fn ref_num(&self) -> usize {
+        self.refs.len()
+    }
+
+    pub fn position(&self, record: &Record) -> Option<[f32; 3]> {
+        self.ids
+            .get(&(record.raw as usize))
+            .map(|&i| self.positions[i])
+    }
+
+    /// Returns the winning `CELL` record at the given grid coordinates.
+    pub fn cell(&self, space: Option<&Record>, x: i32, y: i32) -> Option<Record> {
+        let c = self.lookup(space)?.cells.get(&(x, y))?;
+        c.cell.map(|raw| Record { raw })
+    }
+
+    /// Returns the winning `LAND` record at the given grid coordinates.
+    pub fn land(&self, space: Option<&Record>, x: i32, y: i32) -> Option<Record> {
+        let c = self.lookup(space)?.cells.get(&(x, y))?;
+        c.land.map(|raw| Record { raw })
+    }
+
+    pub fn cell_refs(&self, space: Option<&Record>, x: i32, y: i32) -> Vec<Record> {
+        self.lookup(space)
+            .and_then(|w| w.cells.get(&(x, y)))
+            .map_or_else(Vec::new, |c| self.to_records(&c.refs))
+    }
+
+    /// Returns the cells whose grid coordinates fall within the given inclusive bounds.
+    pub fn cells_in_rect(
+        &self,
+        space: Option<&Record>,
+        min: (i32, i32),
+        max: (i32, i32),
+    ) -> Vec<Record> {
+        self.lookup(space).map_or_else(Vec::new, |grid| {
+            grid.squares(min, max)
+                .into_iter()
+                .filter_map(|c| c.cell.map(|raw| Record { raw }))
+                .collect()
+        })
+    }
+
+    /// Returns the references whose position falls within the given inclusive bounds.
+    pub fn in_rect(&self, space: Option<&Record>, min: (f32, f32), max: (f32, f32)) -> Vec<Record> {
+        let ids = self.candidates(space, min, max);
+        let found: Vec<usize> = ids
+            .into_iter()
+            .filter(|&i| {
+                let p = self.positions[i];
+                p[0] >= min.0 && p[0] <= max.0 && p[1] >= min.1 && p[1] <= max.1
+            })
+            .collect();
+        self.to_records(&found)
+    }
+
+    pub fn in_radius(&self, space: Option<&Record>, center: [f32; 3], radius: f32) -> Vec<Record> {
+        let min = (center[0] - radius, center[1] - radius);
+        let max = (center[0] + radius, center[1] + radius);
+        let ids = self.candidates(space, min, max);
+        let radius_sq = radius * radius;
+        let found: Vec<usize> = ids
+            .into_iter()
+            .filter(|&i| {
+                let p = self.positions[i];
+                let (dx, dy, dz) = (p[0] - center[0], p[1] - center[1], p[2] - center[2]);
+                dx * dx + dy * dy + dz * dz <= radius_sq
+            })
+            .collect();
+        self.to_records(&found)
+    }
+
+    fn lookup(&self, space: Option<&Record>) -> Option<&Space> {
+        let key = space.map_or(0, |s| formid(s.raw));
+        self.spaces.get(&key)
+    }
+
+    fn candidates(&self, space: Option<&Record>, min: (f32, f32), max: (f32, f32)) -> Vec<usize> {
+        let grid = match self.lookup(space) {
+            Some(w) => w,
+            None => return Vec::new(),
+        };
+        let min = (grid_coord(min.0), grid_coord(min.1));
+        let max = (grid_coord(max.0), grid_coord(max.1));
+        let mut ids = Vec::new();
+        for c in grid.squares(min, max) {
+            ids.extend_from_slice(&c.refs);
+        }
+        ids
+    }
+
+    fn to_records(&self, ids: &[usize]) -> Vec<Record> {
+        ids.iter().map(|&i| Record { raw: self.refs[i] }).collect()
+    }
+}
+
+/// Returns the space of a cell's children and, for exterior cells, the cell's grid coordinates.
+fn cell_space(cell: *mut raw::cb_record_t, fields: &SpatialFields) -> (u32, Option<(i32, i32)>) {
+    let wrld = fields::parent_record(cell);
+    if wrld.is_null() {
+        return (formid(cell), None);
+    }
+    let x = fields::read_scalar(cell, fields.cell_x, 4);
+    let y = fields::read_scalar(cell, fields.cell_y, 4);
+    let grid = match (x, y) {
+        (Some(x), Some(y)) => Some((read_u32(&x) as i32, read_u32(&y) as i32)),
+        _ => None,
+    };
+    (formid(wrld), grid)
+}
+
+fn formid(rec: *mut raw::cb_record_t) -> u32 {
+    fields::read_scalar(rec, [fields::FORMID_FIELD, 0, 0, 0, 0, 0, 0], 4)
+        .map(|b| read_u32(&b))
+        .expect("Failed to read record formid.")
+}
+
+fn grid_coord(pos: f32) -> i32 {
+    (pos / CELL_SIZE).floor() as i32
+}
+
+fn read_f32(rec: *mut raw::cb_record_t, path: [u32; 7]) -> Option<f32> {
+    fields::read_scalar(rec, path, 4).map(|b| f32::from_bits(read_u32(&b)))
+}
+
+fn parent_field(rec: &Record) -> Option<u32> {
+    fields::first_field_of_type(rec.raw, raw::cb_field_type_t_CB_PARENTRECORD_FIELD)
+}
+
+fn parent(rec: *mut raw::cb_record_t, field: u32) -> *mut raw::cb_record_t {
+    unsafe { raw::cb_GetField(rec, field, 0, 0, 0, 0, 0, 0, null_mut()) as *mut raw::cb_record_t }
+}
@@ -0,0 +1,126 @@
+use std::collections::HashMap;
+use std::fs::File;
+use std::path::{Path, PathBuf};
+
+use memmap::Mmap;
+use num_enum::{IntoPrimitive, TryFromPrimitive};
+
+use super::fields;
+use super::plugin::read_u32;
+use super::record::Record;
+
+/// The string file a localized field's string IDs index into.
+#[derive(TryFromPrimitive, IntoPrimitive, Clone, Copy)]
+#[repr(i32)]
+pub enum StringKind {
+    /// Names and other short strings, e.g. `FULL`.
+    Strings = 0,
+    /// Descriptions and book text, e.g. `DESC`.
+    DLStrings = 1,
+    /// Dialogue responses, e.g. the `NAM1` of `INFO` records.
+    ILStrings = 2,
+}
+
+/// Extensions of the localized string files, by `StringKind`, and whether
+/// their entries are length-prefixed.
+const TABLE_KINDS: [(&str, bool); 3] =
+    [("STRINGS", false), ("DLSTRINGS", true), ("ILSTRINGS", true)];
+
+struct StringTable {
+    map: Mmap,
+    offsets: HashMap<u32, usize>,
+    prefixed: bool,
+}
+
+impl StringTable {
+    /// Maps a string file, or returns `None` if it is missing or too short
+    /// for the directory it declares.
+    fn open(path: &Path, prefixed: bool) -> Option<StringTable> {
+        let file = File::open(path).ok()?;
+        let map = unsafe { Mmap::map(&file).ok()? };
+        let count = read_u32(map.get(..8)?) as usize;
+        let data_start = count.checked_mul(8)?.checked_add(8)?;
+        let directory = map.get(8..data_start)?;
+        let mut offsets = HashMap::with_capacity(count);
+        for entry in directory.chunks(8) {
+            offsets.insert(read_u32(entry), data_start + read_u32(&entry[4..]) as usize);
+        }
+        Some(StringTable {
+            map,
+            offsets,
+            prefixed,
+        })
+    }
+
+    fn get(&self, id: u32) -> Option<&[u8]> {
+        let mut start = *self.offsets.get(&id)?;
+        let data = &self.map[..];
+        let end = if self.prefixed {
+            let len = read_u32(data.get(start..start + 4)?) as usize;
+            start += 4;
+            start + len
+        } else {
+            start + data.get(start..)?.iter().position(|&b| b == 0)?
+        };
+        let bytes = data.get(start..end)?;
+        bytes.split(|&b| b == 0).next()
+    }
+}
+
+/// Lazily mapped `.STRINGS`, `.DLSTRINGS` and `.ILSTRINGS` files of a localized Skyrim plugin.
+///
+/// Files are only mapped the first time a lookup needs them, and strings are
+/// read straight out of the mapping.
+pub struct StringTables {
+    dir: PathBuf,
+    prefix: String,
+    tables: [Option<Option<StringTable>>; 3],
+}
+
+impl StringTables {
+    /// `path` is the game's data directory, as given to `Collection::new`.
+    ///
+    /// `ModFile::string_tables` opens the tables of a loaded plugin.
+    pub fn new(path: &str, plugin: &str, language: &str) -> StringTables {
+        let stem = Path::new(plugin)
+            .file_stem()
+            .and_then(|s| s.to_str())
+            .expect("Failed to parse plugin name.");
+        StringTables {
+            dir: Path::new(path).join("Strings"),
+            prefix: format!("{}_{}", stem, language),
+            tables: [None, None, None],
+        }
+    }
+
+    /// Resolves a localized string ID in the given string file.
+    ///
+    /// The string is returned undecoded, in the code page of the table's
+    /// language, e.g. cp1252 for English or French.
+    pub fn get(&mut self, kind: StringKind, id: u32) -> Option<&[u8]> {
+        self.table(kind as usize)?.get(id)
+    }
+
+    /// Resolves the string ID held by a field of a localized plugin's record.
+    ///
+    /// Returns `None` for fields that are not 32-bit values, or hold no string.
+    pub fn field(&mut self, record: &Record, path: [u32; 7], kind: StringKind) -> Option<&[u8]> {
+        let field_type = fields::attribute(record.raw, path, fields::TYPE_ATTRIBUTE);
+        if fields::scalar_size(field_type) != Some(4) {
+            return None;
+        }
+        match fields::read_scalar(record.raw, path, 4).map(|b| read_u32(&b))? {
+            0 => None,
+            id => self.get(kind, id),
+        }
+    }
+
+    fn table(&mut self, kind: usize) -> Option<&StringTable> {
+        if self.tables[kind].is_none() {
+            let (ext, prefixed) = TABLE_KINDS[kind];
+            let path = self.dir.join(format!("{}.{}", self.prefix, ext));
+            self.tables[kind] = Some(StringTable::open(&path, prefixed));
+        }
+        self.tables[kind].as_ref()?.as_ref()
+    }
+}
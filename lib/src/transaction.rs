@@ -0,0 +1,327 @@
+use std::collections::{HashMap, HashSet};
+use std::ffi::{CStr, CString};
+use std::ptr::null_mut;
+use std::sync::{Mutex, MutexGuard, PoisonError};
+
+use lazy_static::lazy_static;
+
+use super::fields::{self, FieldValue};
+use super::modfile::ModFile;
+use super::plugin::read_u32;
+use super::raw;
+use super::record::RecordFlags;
+
+/// A record's field values from before its first edit in a transaction.
+struct Snapshot {
+    formid: u32,
+    editor_id: Option<Vec<u8>>,
+    fields: Vec<([u32; 7], FieldValue)>,
+}
+
+impl Snapshot {
+    fn take(rec: *mut raw::cb_record_t) -> Snapshot {
+        let mut snapshot = Snapshot {
+            formid: 0,
+            editor_id: None,
+            fields: Vec::new(),
+        };
+        fields::walk(rec, &mut |path, value| match (path[0], value) {
+            (fields::FORMID_FIELD, FieldValue::FormID(formid)) => snapshot.formid = formid,
+            (fields::EDITORID_FIELD, FieldValue::String(edid)) => snapshot.editor_id = Some(edid),
+            (fields::FORMID_FIELD, _) | (fields::EDITORID_FIELD, _) => {}
+            (_, value) => snapshot.fields.push((path, value)),
+        });
+        snapshot
+    }
+
+    fn restore(&self, rec: *mut raw::cb_record_t) {
+        for (path, value) in self.fields.iter() {
+            fields::write(rec, *path, value);
+        }
+        // the IDs go through cb_SetIDFields so the mod's lookups follow them
+        let formid = fields::read_scalar(rec, [fields::FORMID_FIELD, 0, 0, 0, 0, 0, 0], 4)
+            .map(|b| read_u32(&b));
+        let edid = fields::read_string(rec, [fields::EDITORID_FIELD, 0, 0, 0, 0, 0, 0]);
+        if formid != Some(self.formid) || edid != self.editor_id {
+            let c_edid = self
+                .editor_id
+                .as_ref()
+                .map_or(null_mut(), |e| CString::new(e.clone()).unwrap().into_raw());
+            unsafe {
+                raw::cb_SetIDFields(rec, self.formid, c_edid);
+                if !c_edid.is_null() {
+                    let _string = CString::from_raw(c_edid);
+                }
+            }
+        }
+    }
+}
+
+/// A record deleted inside a transaction, as it was before the transaction.
+struct Deleted {
+    rec_type: [u8; 4],
+    /// The record's parent, which may itself have been deleted.
+    parent: usize,
+    /// The number of parents above the record, so parents are recreated first.
+    depth: usize,
+    is_override: bool,
+    snapshot: Snapshot,
+}
+
+impl Deleted {
+    fn recreate(
+        &self,
+        r#mod: *mut raw::cb_mod_t,
+        parent: *mut raw::cb_record_t,
+    ) -> Option<*mut raw::cb_record_t> {
+        let flags = if self.is_override {
+            RecordFlags::SET_AS_OVERRIDE
+        } else {
+            RecordFlags::empty()
+        };
+        let c_edid = self
+            .snapshot
+            .editor_id
+            .as_ref()
+            .map_or(null_mut(), |e| CString::new(e.clone()).unwrap().into_raw());
+        let rec = unsafe {
+            let rec = raw::cb_CreateRecord(
+                r#mod,
+                u32::from_le_bytes(self.rec_type),
+                self.snapshot.formid,
+                c_edid,
+                parent,
+                flags.bits(),
+            );
+            if !c_edid.is_null() {
+                let _string = CString::from_raw(c_edid);
+            }
+            rec
+        };
+        if rec.is_null() {
+            return None;
+        }
+        self.snapshot.restore(rec);
+        Some(rec)
+    }
+}
+
+#[derive(Default)]
+struct Changes {
+    /// Records edited so far, as they were before their first edit.
+    snapshots: HashMap<usize, Snapshot>,
+    created: Vec<usize>,
+    deleted: Vec<(usize, Deleted)>,
+}
+
+lazy_static! {
+    static ref ACTIVE: Mutex<HashMap<usize, Changes>> = Mutex::new(HashMap::new());
+}
+
+fn active() -> MutexGuard<'static, HashMap<usize, Changes>> {
+    // a panic while holding the lock leaves the map itself intact
+    ACTIVE.lock().unwrap_or_else(PoisonError::into_inner)
+}
+
+/// Saves a record ahead of an edit, if its mod has an open transaction.
+pub(super) fn track_changed(rec: *mut raw::cb_record_t) {
+    let mut active = active();
+    if active.is_empty() {
+        return;
+    }
+    let r#mod = unsafe { raw::cb_GetModIDByRecordID(rec) };
+    if let Some(changes) = active.get_mut(&(r#mod as usize)) {
+        if !changes.created.contains(&(rec as usize)) {
+            changes
+                .snapshots
+                .entry(rec as usize)
+                .or_insert_with(|| Snapshot::take(rec));
+        }
+    }
+}
+
+/// Saves every record of `r#mod` ahead of an edit that may touch any of them.
+pub(super) fn track_all(r#mod: &ModFile) {
+    if !active().contains_key(&(r#mod.raw as usize)) {
+        return;
+    }
+    for rec_type in r#mod.present_types() {
+        for rec in r#mod.records(rec_type) {
+            track_changed(rec.raw);
+        }
+    }
+}
+
+/// Records a record added to `r#mod`, if it has an open transaction.
+pub(super) fn track_created(r#mod: *mut raw::cb_mod_t, rec: *mut raw::cb_record_t) {
+    if let Some(changes) = active().get_mut(&(r#mod as usize)) {
+        changes.created.push(rec as usize);
+    }
+}
+
+/// Saves a record about to be deleted, along with the records nested under it,
+/// if its mod has an open transaction.
+///
+/// Records created inside the transaction are just forgotten.
+pub(super) fn track_deleted(rec: *mut raw::cb_record_t) {
+    let r#mod = ModFile {
+        raw: unsafe { raw::cb_GetModIDByRecordID(rec) },
+    };
+    if !active().contains_key(&(r#mod.raw as usize)) {
+        return;
+    }
+    // CBash cannot tell a record's type, so the deleted records are looked up by type
+    let mut nested = Vec::new();
+    for rec_type in r#mod.present_types() {
+        for child in r#mod.records(rec_type) {
+            if is_within(child.raw, rec) {
+                nested.push((rec_type, child.raw));
+            }
+        }
+    }
+    if !nested.iter().any(|(_, r)| *r == rec) {
+        panic!("Failed to save record for rollback.")
+    }
+
+    let mut active = active();
+    let changes = match active.get_mut(&(r#mod.raw as usize)) {
+        Some(changes) => changes,
+        None => return,
+    };
+    for (rec_type, child) in nested {
+        let key = child as usize;
+        if let Some(i) = changes.created.iter().position(|r| *r == key) {
+            changes.created.remove(i);
+            continue;
+        }
+        let snapshot = changes
+            .snapshots
+            .remove(&key)
+            .unwrap_or_else(|| Snapshot::take(child));
+        let deleted = Deleted {
+            rec_type,
+            parent: fields::parent_record(child) as usize,
+            depth: depth(child),
+            is_override: is_override(child, snapshot.formid),
+            snapshot,
+        };
+        changes.deleted.push((key, deleted));
+    }
+}
+
+fn is_within(rec: *mut raw::cb_record_t, ancestor: *mut raw::cb_record_t) -> bool {
+    let mut rec = rec;
+    while !rec.is_null() {
+        if rec == ancestor {
+            return true;
+        }
+        rec = fields::parent_record(rec);
+    }
+    false
+}
+
+fn depth(rec: *mut raw::cb_record_t) -> usize {
+    let mut depth = 0;
+    let mut parent = fields::parent_record(rec);
+    while !parent.is_null() {
+        depth += 1;
+        parent = fields::parent_record(parent);
+    }
+    depth
+}
+
+/// Whether a record overrides one of its mod's masters, rather than being new to it.
+fn is_override(rec: *mut raw::cb_record_t, formid: u32) -> bool {
+    unsafe {
+        let master = raw::cb_GetLongIDName(rec, formid, false);
+        let name = raw::cb_GetModNameByID(raw::cb_GetModIDByRecordID(rec));
+        if master.is_null() || name.is_null() {
+            return false;
+        }
+        !CStr::from_ptr(master)
+            .to_bytes()
+            .eq_ignore_ascii_case(CStr::from_ptr(name).to_bytes())
+    }
+}
+
+/// Undo scope over the edits made to one mod.
+///
+/// A record's field values are saved the first time it is edited inside the
+/// transaction, so untouched records keep sharing the loaded data, and before
+/// it is deleted. Rolling back deletes the records created since
+/// `ModFile::begin_transaction`, recreates the deleted ones and writes the
+/// saved values back. Dropping an uncommitted transaction rolls it back.
+///
+/// Junk and subrecord fields are not restored. Recreated records are new
+/// CBash records, so `Record`s taken before their deletion stay invalid.
+pub struct Transaction {
+    raw: *mut raw::cb_mod_t,
+    done: bool,
+}
+
+impl Transaction {
+    pub(super) fn begin(r#mod: *mut raw::cb_mod_t) -> Transaction {
+        let mut active = active();
+        if active.contains_key(&(r#mod as usize)) {
+            panic!("Failed to begin transaction, mod already has one open.")
+        }
+        active.insert(r#mod as usize, Changes::default());
+        Transaction {
+            raw: r#mod,
+            done: false,
+        }
+    }
+
+    pub fn changed_num(&self) -> usize {
+        active()
+            .get(&(self.raw as usize))
+            .map_or(0, |c| c.snapshots.len() + c.created.len() + c.deleted.len())
+    }
+
+    pub fn commit(mut self) {
+        self.finish(false)
+    }
+
+    pub fn rollback(mut self) {
+        self.finish(true)
+    }
+
+    fn finish(&mut self, rollback: bool) {
+        if self.done {
+            return;
+        }
+        self.done = true;
+        let changes = active().remove(&(self.raw as usize)).unwrap_or_default();
+        if !rollback {
+            return;
+        }
+        for rec in changes.created.iter().rev() {
+            // this may run while dropping, so a record that fails to delete is left in place
+            unsafe { raw::cb_DeleteRecord(*rec as *mut raw::cb_record_t) };
+        }
+        let mut deleted = changes.deleted;
+        deleted.sort_by_key(|(_, d)| d.depth);
+        let deleted_keys: HashSet<usize> = deleted.iter().map(|(r, _)| *r).collect();
+        let mut recreated: HashMap<usize, *mut raw::cb_record_t> = HashMap::new();
+        for (rec, record) in deleted.iter() {
+            let parent = match recreated.get(&record.parent) {
+                Some(parent) => *parent,
+                // a parent that failed to be recreated leaves its children out
+                None if deleted_keys.contains(&record.parent) => continue,
+                None => record.parent as *mut raw::cb_record_t,
+            };
+            if let Some(new) = record.recreate(self.raw, parent) {
+                recreated.insert(*rec, new);
+            }
+        }
+        for (rec, snapshot) in changes.snapshots.iter() {
+            snapshot.restore(*rec as *mut raw::cb_record_t);
+        }
+    }
+}
+
+impl Drop for Transaction {
+    fn drop(&mut self) {
+        self.finish(true)
+    }
+}
@@ -0,0 +1,76 @@
+use super::collection::CollectionType;
+
+const OBLIVION_TYPES: &[&[u8; 4]] = &[
+    b"GMST", b"GLOB", b"CLAS", b"FACT", b"HAIR", b"EYES", b"RACE", b"SOUN", b"SKIL", b"MGEF",
+    b"SCPT", b"LTEX", b"ENCH", b"SPEL", b"BSGN", b"ACTI", b"APPA", b"ARMO", b"BOOK", b"CLOT",
+    b"CONT", b"DOOR", b"INGR", b"LIGH", b"MISC", b"STAT", b"GRAS", b"TREE", b"FLOR", b"FURN",
+    b"WEAP", b"AMMO", b"NPC_", b"CREA", b"LVLC", b"SLGM", b"KEYM", b"ALCH", b"SBSP", b"SGST",
+    b"LVLI", b"WTHR", b"CLMT", b"REGN", b"CELL", b"WRLD", b"DIAL", b"QUST", b"IDLE", b"PACK",
+    b"CSTY", b"LSCR", b"LVSP", b"ANIO", b"WATR", b"EFSH", b"REFR", b"ACHR", b"ACRE", b"PGRD",
+    b"LAND", b"ROAD", b"INFO",
+];
+
+const FALLOUT3_TYPES: &[&[u8; 4]] = &[
+    b"GMST", b"TXST", b"MICN", b"GLOB", b"CLAS", b"FACT", b"HDPT", b"HAIR", b"EYES", b"RACE",
+    b"SOUN", b"ASPC", b"MGEF", b"SCPT", b"LTEX", b"ENCH", b"SPEL", b"ACTI", b"TACT", b"TERM",
+    b"ARMO", b"BOOK", b"CONT", b"DOOR", b"INGR", b"LIGH", b"MISC", b"STAT", b"SCOL", b"MSTT",
+    b"PWAT", b"GRAS", b"TREE", b"FURN", b"WEAP", b"AMMO", b"NPC_", b"CREA", b"LVLC", b"LVLN",
+    b"KEYM", b"ALCH", b"IDLM", b"NOTE", b"COBJ", b"PROJ", b"LVLI", b"WTHR", b"CLMT", b"REGN",
+    b"NAVI", b"CELL", b"WRLD", b"DIAL", b"QUST", b"IDLE", b"PACK", b"CSTY", b"LSCR", b"ANIO",
+    b"WATR", b"EFSH", b"EXPL", b"DEBR", b"IMGS", b"IMAD", b"FLST", b"PERK", b"BPTD", b"ADDN",
+    b"AVIF", b"RADS", b"CAMS", b"CPTH", b"VTYP", b"IPCT", b"IPDS", b"ARMA", b"ECZN", b"MESG",
+    b"RGDL", b"DOBJ", b"LGTM", b"MUSC", b"REFR", b"ACHR", b"ACRE", b"PGRE", b"PMIS", b"PBEA",
+    b"PFLA", b"PCBE", b"NAVM", b"LAND", b"INFO",
+];
+
+const NEW_VEGAS_TYPES: &[&[u8; 4]] = &[
+    b"IMOD", b"REPU", b"RCPE", b"RCCT", b"CHIP", b"CSNO", b"LSCT", b"MSET", b"ALOC", b"CHAL",
+    b"AMEF", b"CCRD", b"CMNY", b"CDCK", b"DEHY", b"HUNG", b"SLPD",
+];
+
+const SKYRIM_TYPES: &[&[u8; 4]] = &[
+    b"GMST", b"KYWD", b"LCRT", b"AACT", b"TXST", b"GLOB", b"CLAS", b"FACT", b"HDPT", b"EYES",
+    b"RACE", b"SOUN", b"ASPC", b"MGEF", b"LTEX", b"ENCH", b"SPEL", b"SCRL", b"ACTI", b"TACT",
+    b"ARMO", b"BOOK", b"CONT", b"DOOR", b"INGR", b"LIGH", b"MISC", b"APPA", b"STAT", b"SCOL",
+    b"MSTT", b"PWAT", b"GRAS", b"TREE", b"CLDC", b"FLOR", b"FURN", b"WEAP", b"AMMO", b"NPC_",
+    b"LVLN", b"KEYM", b"ALCH", b"IDLM", b"COBJ", b"PROJ", b"HAZD", b"SLGM", b"LVLI", b"WTHR",
+    b"CLMT", b"SPGD", b"RFCT", b"REGN", b"NAVI", b"CELL", b"WRLD", b"DIAL", b"QUST", b"IDLE",
+    b"PACK", b"CSTY", b"LSCR", b"LVSP", b"ANIO", b"WATR", b"EFSH", b"EXPL", b"DEBR", b"IMGS",
+    b"IMAD", b"FLST", b"PERK", b"BPTD", b"ADDN", b"AVIF", b"CAMS", b"CPTH", b"VTYP", b"MATT",
+    b"IPCT", b"IPDS", b"ARMA", b"ECZN", b"LCTN", b"MESG", b"RGDL", b"DOBJ", b"LGTM", b"MUSC",
+    b"FSTP", b"FSTS", b"SMBN", b"SMQN", b"SMEN", b"DLBR", b"MUST", b"DLVW", b"WOOP", b"SHOU",
+    b"EQUP", b"RELA", b"SCEN", b"ASTP", b"OTFT", b"ARTO", b"MATO", b"MOVT", b"SNDR", b"DUAL",
+    b"SNCT", b"SOPM", b"COLL", b"CLFM", b"REVB", b"REFR", b"ACHR", b"PGRE", b"PHZD", b"PARW",
+    b"PBAR", b"PBEA", b"PCON", b"PFLA", b"NAVM", b"LAND", b"INFO",
+];
+
+/// Record types nested in `CELL` groups, or in the cells of `WRLD` groups.
+const CELL_CHILD_TYPES: &[&[u8; 4]] = &[
+    b"CELL", b"REFR", b"ACHR", b"ACRE", b"PGRE", b"PMIS", b"PBEA", b"PFLA", b"PCBE", b"PHZD",
+    b"PARW", b"PBAR", b"PCON", b"PGRD", b"NAVM", b"LAND",
+];
+
+/// Every record type a collection of the given game can hold, as passed to `ModFile::records`.
+///
+/// Types nested in other groups, such as placed references and dialogue
+/// responses, are included.
+pub(super) fn record_types(kind: CollectionType) -> Vec<[u8; 4]> {
+    let types: Vec<&[u8; 4]> = match kind {
+        CollectionType::Oblivion => OBLIVION_TYPES.to_vec(),
+        CollectionType::Fallout3 => FALLOUT3_TYPES.to_vec(),
+        CollectionType::FalloutNewVegas => [FALLOUT3_TYPES, NEW_VEGAS_TYPES].concat(),
+        CollectionType::Skyrim => SKYRIM_TYPES.to_vec(),
+        CollectionType::Unknown => Vec::new(),
+    };
+    types.into_iter().copied().collect()
+}
+
+/// The top-level groups that can hold records of the given type.
+pub(super) fn top_level_groups(rec_type: [u8; 4]) -> Vec<[u8; 4]> {
+    match &rec_type {
+        b"ROAD" => vec![*b"WRLD"],
+        b"INFO" => vec![*b"DIAL"],
+        t if CELL_CHILD_TYPES.contains(&t) => vec![*b"CELL", *b"WRLD"],
+        _ => vec![rec_type],
+    }
+}
@@ -0,0 +1,127 @@
+use std::collections::HashMap;
+use std::convert::TryInto;
+use std::ptr::null_mut;
+
+use super::collection::Collection;
+use super::fields::{self, FieldValue};
+use super::raw;
+use super::record::Record;
+
+/// Object IDs below this in the first master are reserved for forms the
+/// engine defines itself, such as the player's reference, and are not
+/// stored in the master.
+const RESERVED_OBJECT_IDS: u32 = 0x800;
+
+#[derive(Clone, Copy, PartialEq, Debug)]
+pub enum InvalidReason {
+    /// The FormID's mod index points past the collection's load order.
+    MissingMaster,
+    /// The referenced master is loaded but has no record with this FormID.
+    MissingRecord,
+}
+
+impl InvalidReason {
+    pub fn as_str(self) -> &'static str {
+        match self {
+            InvalidReason::MissingMaster => "missing master",
+            InvalidReason::MissingRecord => "missing record",
+        }
+    }
+}
+
+pub struct InvalidReference {
+    pub record: Record,
+    /// Field identifiers of the offending field, as passed to `Record::get_field`.
+    pub path: [u32; 7],
+    pub formid: u32,
+    pub reason: InvalidReason,
+}
+
+pub struct ValidationReport {
+    refs: Vec<InvalidReference>,
+}
+
+impl ValidationReport {
+    pub fn len(&self) -> usize {
+        self.refs.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.refs.is_empty()
+    }
+
+    pub fn iter(&self) -> std::slice::Iter<'_, InvalidReference> {
+        self.refs.iter()
+    }
+}
+
+impl IntoIterator for ValidationReport {
+    type Item = InvalidReference;
+    type IntoIter = std::vec::IntoIter<InvalidReference>;
+
+    fn into_iter(self) -> Self::IntoIter {
+        self.refs.into_iter()
+    }
+}
+
+/// Checks every FormID field of every record in the collection's load order.
+///
+/// Every record type of the game is looked at, so mods holding only
+/// overrides are covered too.
+///
+/// Each distinct FormID is only looked up once. FormIDs in the first
+/// master's reserved range are never reported.
+pub(super) fn validate_references(collection: &Collection) -> ValidationReport {
+    let mods = collection.load_order_mods();
+    let mod_num: u32 = mods.len().try_into().unwrap();
+    let mut checked: HashMap<u32, Option<InvalidReason>> = HashMap::new();
+    let mut refs = Vec::new();
+    for r#mod in mods.iter() {
+        for rec_type in r#mod.present_types() {
+            for rec in r#mod.records(rec_type) {
+                let mut check = |path: [u32; 7], formid: u32| {
+                    if formid >> 24 == 0 && formid & 0x00FF_FFFF < RESERVED_OBJECT_IDS {
+                        return;
+                    }
+                    let reason = *checked.entry(formid).or_insert_with(|| {
+                        let index = formid >> 24;
+                        if index >= mod_num {
+                            return Some(InvalidReason::MissingMaster);
+                        }
+                        let found = unsafe {
+                            raw::cb_GetRecordID(mods[index as usize].raw, formid, null_mut())
+                        };
+                        if found.is_null() {
+                            Some(InvalidReason::MissingRecord)
+                        } else {
+                            None
+                        }
+                    });
+                    if let Some(reason) = reason {
+                        refs.push(InvalidReference {
+                            record: Record { raw: rec.raw },
+                            path,
+                            formid,
+                            reason,
+                        });
+                    }
+                };
+                fields::walk(rec.raw, &mut |path, value| match value {
+                    FieldValue::FormID(formid) => check(path, formid),
+                    FieldValue::FormIDs(formids) => {
+                        for formid in formids {
+                            check(path, formid)
+                        }
+                    }
+                    FieldValue::MixedIDs(values) => {
+                        for (formid, _) in values.into_iter().filter(|(_, is_formid)| *is_formid) {
+                            check(path, formid)
+                        }
+                    }
+                    _ => {}
+                });
+            }
+        }
+    }
+    ValidationReport { refs }
+}
@@ -1,3 +1,4 @@
+use std::collections::HashMap;
 use std::convert::TryFrom;
 
 use pyo3::exceptions::ValueError;
@@ -5,8 +6,9 @@ use pyo3::prelude::*;
 
 use rbash;
 
-use super::modfile::ModFile;
+use super::modfile::{convert_rec_type, ModFile};
 use super::record::Record;
+use super::spatial::{convert_fields, SpatialIndex};
 
 #[pyclass(module = "rbash")]
 pub struct Collection {
@@ -36,6 +38,19 @@ impl Collection {
         Ok(ModFile { raw })
     }
 
+    fn add_mod_filtered(
+        &self,
+        name: &str,
+        flags: i32,
+        rec_types: Vec<String>,
+    ) -> PyResult<ModFile> {
+        let flags = rbash::ModFlags::from_bits(flags)
+            .ok_or_else(|| PyErr::new::<ValueError, _>("Incorrect ModFlags value."))?;
+        let rec_types: Vec<[u8; 4]> = rec_types.iter().map(|t| convert_rec_type(t)).collect();
+        let raw = self.raw.add_mod_filtered(name, flags, &rec_types);
+        Ok(ModFile { raw })
+    }
+
     fn mod_num(&self) -> i32 {
         self.raw.mod_num()
     }
@@ -88,10 +103,56 @@ impl Collection {
         self.raw.has_updated_references(record.map(|r| &r.raw))
     }
 
+    fn fingerprints(&self, rec_type: &str) -> HashMap<(String, u32), u64> {
+        let rec_type = convert_rec_type(rec_type);
+        self.raw.fingerprints(rec_type)
+    }
+
+    fn diff(
+        &self,
+        old: &Collection,
+        rec_types: Vec<String>,
+    ) -> (Vec<(String, u32)>, Vec<(String, u32)>, Vec<(String, u32)>) {
+        let rec_types: Vec<[u8; 4]> = rec_types.iter().map(|t| convert_rec_type(t)).collect();
+        let diff = self.raw.diff(&old.raw, &rec_types);
+        (diff.added, diff.removed, diff.changed)
+    }
+
+    fn validate_references(&self) -> Vec<(Record, Vec<u32>, u32, &'static str)> {
+        self.raw
+            .validate_references()
+            .into_iter()
+            .map(|r| {
+                let path = r.path.to_vec();
+                (Record { raw: r.record }, path, r.formid, r.reason.as_str())
+            })
+            .collect()
+    }
+
     fn load(&self) {
         self.raw.load()
     }
 
+    fn spatial_index(
+        &self,
+        pos_x: Vec<u32>,
+        pos_y: Vec<u32>,
+        pos_z: Vec<u32>,
+        cell_x: Vec<u32>,
+        cell_y: Vec<u32>,
+    ) -> SpatialIndex {
+        let fields = rbash::SpatialFields {
+            pos_x: convert_fields(&pos_x),
+            pos_y: convert_fields(&pos_y),
+            pos_z: convert_fields(&pos_z),
+            cell_x: convert_fields(&cell_x),
+            cell_y: convert_fields(&cell_y),
+        };
+        SpatialIndex {
+            raw: self.raw.spatial_index(&fields),
+        }
+    }
+
     fn unload(&self) {
         self.raw.unload()
     }
@@ -47,6 +47,15 @@ pub fn ModFlags(_py: Python, m: &PyModule) -> PyResult<()> {
     Ok(())
 }
 
+#[pymodule]
+pub fn StringKind(_py: Python, m: &PyModule) -> PyResult<()> {
+    m.add::<i32>("Strings", rbash::StringKind::Strings.into())?;
+    m.add::<i32>("DLStrings", rbash::StringKind::DLStrings.into())?;
+    m.add::<i32>("ILStrings", rbash::StringKind::ILStrings.into())?;
+
+    Ok(())
+}
+
 #[pymodule]
 pub fn RecordFlags(_py: Python, m: &PyModule) -> PyResult<()> {
     m.add::<i32>(
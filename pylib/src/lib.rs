@@ -1,17 +1,25 @@
 mod collection;
 mod enums;
 mod modfile;
+mod plugin;
 mod record;
+mod spatial;
+mod strings;
+mod transaction;
 
 use pyo3::prelude::*;
-use pyo3::wrap_pymodule;
+use pyo3::{wrap_pyfunction, wrap_pymodule};
 
 use rbash as rb;
 
 use collection::Collection;
 use enums::*;
 use modfile::ModFile;
+use plugin::*;
 use record::Record;
+use spatial::SpatialIndex;
+use strings::StringTables;
+use transaction::Transaction;
 
 #[pymodule]
 fn rbash(_py: Python, m: &PyModule) -> PyResult<()> {
@@ -19,9 +27,15 @@ fn rbash(_py: Python, m: &PyModule) -> PyResult<()> {
     m.add_wrapped(wrap_pymodule!(CollectionType))?;
     m.add_wrapped(wrap_pymodule!(ModFlags))?;
     m.add_wrapped(wrap_pymodule!(RecordFlags))?;
+    m.add_wrapped(wrap_pymodule!(StringKind))?;
     m.add_class::<Collection>().unwrap();
     m.add_class::<ModFile>().unwrap();
     m.add_class::<Record>().unwrap();
+    m.add_class::<PluginHeader>().unwrap();
+    m.add_class::<SpatialIndex>().unwrap();
+    m.add_class::<StringTables>().unwrap();
+    m.add_class::<Transaction>().unwrap();
+    m.add_wrapped(wrap_pyfunction!(scan_plugin_headers))?;
 
     Ok(())
 }
@@ -9,6 +9,8 @@ use rbash::prelude::*;
 
 use super::collection::Collection;
 use super::record::Record;
+use super::strings::StringTables;
+use super::transaction::Transaction;
 
 #[pyclass(module = "rbash")]
 pub struct ModFile {
@@ -126,6 +128,11 @@ impl ModFile {
             .collect()
     }
 
+    fn fingerprints(&self, rec_type: &str) -> HashMap<(String, u32), u64> {
+        let rec_type = convert_rec_type(rec_type);
+        self.raw.fingerprints(rec_type)
+    }
+
     fn save(&self, name: &str) {
         self.raw.save(name)
     }
@@ -137,6 +144,24 @@ impl ModFile {
         }
     }
 
+    fn merge_leveled_lists(&self, rec_type: &str, entries: u32, members: Vec<u32>) -> usize {
+        let rec_type = convert_rec_type(rec_type);
+        let fields = rbash::LeveledListFields { entries, members };
+        self.raw.merge_leveled_lists(rec_type, &fields)
+    }
+
+    fn string_tables(&self, language: &str) -> Option<StringTables> {
+        self.raw
+            .string_tables(language)
+            .map(|raw| StringTables { raw })
+    }
+
+    fn begin_transaction(&self) -> Transaction {
+        Transaction {
+            raw: Some(self.raw.begin_transaction()),
+        }
+    }
+
     fn load(&self) {
         self.raw.load()
     }
@@ -146,7 +171,7 @@ impl ModFile {
     }
 }
 
-fn convert_rec_type(rec_type: &str) -> [u8; 4] {
+pub(super) fn convert_rec_type(rec_type: &str) -> [u8; 4] {
     let array = rec_type.bytes().take(4).collect::<Vec<_>>();
     let mut rec_type = [0_u8; 4];
     rec_type.copy_from_slice(&array[..4]);
@@ -0,0 +1,77 @@
+use pyo3::prelude::*;
+
+use rbash;
+
+#[pyclass(module = "rbash")]
+pub struct PluginHeader {
+    pub(super) raw: rbash::PluginHeader,
+}
+
+#[pymethods]
+impl PluginHeader {
+    #[getter]
+    fn file_name(&self) -> &str {
+        &self.raw.file_name
+    }
+
+    #[getter]
+    fn flags(&self) -> u32 {
+        self.raw.flags
+    }
+
+    #[getter]
+    fn version(&self) -> f32 {
+        self.raw.version
+    }
+
+    #[getter]
+    fn record_num(&self) -> u32 {
+        self.raw.record_num
+    }
+
+    #[getter]
+    fn next_object_id(&self) -> u32 {
+        self.raw.next_object_id
+    }
+
+    #[getter]
+    fn author(&self) -> &str {
+        &self.raw.author
+    }
+
+    #[getter]
+    fn description(&self) -> &str {
+        &self.raw.description
+    }
+
+    #[getter]
+    fn masters(&self) -> Vec<String> {
+        self.raw.masters.clone()
+    }
+
+    #[getter]
+    fn is_master(&self) -> bool {
+        self.raw.is_master()
+    }
+
+    #[getter]
+    fn is_localized(&self) -> bool {
+        self.raw.is_localized()
+    }
+
+    #[getter]
+    fn is_light(&self) -> bool {
+        self.raw.is_light()
+    }
+}
+
+/// Returns the readable headers and the names of the plugins that were skipped.
+#[pyfunction]
+pub fn scan_plugin_headers(path: &str) -> (Vec<PluginHeader>, Vec<String>) {
+    let (headers, skipped) = rbash::scan_plugin_headers(path);
+    let headers = headers
+        .into_iter()
+        .map(|raw| PluginHeader { raw })
+        .collect();
+    (headers, skipped)
+}
@@ -66,6 +66,10 @@ impl Record {
             .collect()
     }
 
+    fn fingerprint(&self) -> u64 {
+        self.raw.fingerprint()
+    }
+
     fn copy_into(
         &self,
         dest: &ModFile,
@@ -0,0 +1,94 @@
+use pyo3::prelude::*;
+
+use rbash;
+
+use super::record::Record;
+
+#[pyclass(module = "rbash")]
+pub struct SpatialIndex {
+    pub(super) raw: rbash::SpatialIndex,
+}
+
+#[pymethods]
+impl SpatialIndex {
+    fn ref_num(&self) -> usize {
+        self.raw.ref_num()
+    }
+
+    fn position(&self, record: &Record) -> Option<(f32, f32, f32)> {
+        self.raw.position(&record.raw).map(|p| (p[0], p[1], p[2]))
+    }
+
+    fn cell(&self, space: Option<&Record>, x: i32, y: i32) -> Option<Record> {
+        self.raw
+            .cell(space.map(|r| &r.raw), x, y)
+            .map(|raw| Record { raw })
+    }
+
+    fn land(&self, space: Option<&Record>, x: i32, y: i32) -> Option<Record> {
+        self.raw
+            .land(space.map(|r| &r.raw), x, y)
+            .map(|raw| Record { raw })
+    }
+
+    fn cell_refs(&self, space: Option<&Record>, x: i32, y: i32) -> Vec<Record> {
+        self.raw
+            .cell_refs(space.map(|r| &r.raw), x, y)
+            .into_iter()
+            .map(|raw| Record { raw })
+            .collect()
+    }
+
+    fn cells_in_rect(
+        &self,
+        space: Option<&Record>,
+        min_x: i32,
+        min_y: i32,
+        max_x: i32,
+        max_y: i32,
+    ) -> Vec<Record> {
+        self.raw
+            .cells_in_rect(space.map(|r| &r.raw), (min_x, min_y), (max_x, max_y))
+            .into_iter()
+            .map(|raw| Record { raw })
+            .collect()
+    }
+
+    fn in_rect(
+        &self,
+        space: Option<&Record>,
+        min_x: f32,
+        min_y: f32,
+        max_x: f32,
+        max_y: f32,
+    ) -> Vec<Record> {
+        self.raw
+            .in_rect(space.map(|r| &r.raw), (min_x, min_y), (max_x, max_y))
+            .into_iter()
+            .map(|raw| Record { raw })
+            .collect()
+    }
+
+    fn in_radius(
+        &self,
+        space: Option<&Record>,
+        x: f32,
+        y: f32,
+        z: f32,
+        radius: f32,
+    ) -> Vec<Record> {
+        self.raw
+            .in_radius(space.map(|r| &r.raw), [x, y, z], radius)
+            .into_iter()
+            .map(|raw| Record { raw })
+            .collect()
+    }
+}
+
+pub(super) fn convert_fields(fields: &[u32]) -> [u32; 7] {
+    let mut array = [0_u32; 7];
+    for (dst, src) in array.iter_mut().zip(fields) {
+        *dst = *src;
+    }
+    array
+}
@@ -0,0 +1,60 @@
+use std::convert::TryFrom;
+
+use pyo3::exceptions::ValueError;
+use pyo3::prelude::*;
+use pyo3::types::PyBytes;
+
+use rbash;
+
+use super::record::Record;
+
+#[pyclass(module = "rbash")]
+pub struct StringTables {
+    pub(super) raw: rbash::StringTables,
+}
+
+#[pymethods]
+impl StringTables {
+    #[new]
+    fn init(obj: &PyRawObject, path: &str, plugin: &str, language: &str) -> PyResult<()> {
+        let raw = rbash::StringTables::new(path, plugin, language);
+        obj.init({ StringTables { raw } });
+        Ok(())
+    }
+
+    /// Returns the string's bytes, to be decoded with the language's code page.
+    fn get(&mut self, py: Python, kind: i32, id: u32) -> PyResult<Option<PyObject>> {
+        let kind = string_kind(kind)?;
+        Ok(self
+            .raw
+            .get(kind, id)
+            .map(|b| PyBytes::new(py, b).to_object(py)))
+    }
+
+    #[args(a = "0", b = "0", c = "0", d = "0", e = "0", f = "0", g = "0")]
+    fn field(
+        &mut self,
+        py: Python,
+        record: &Record,
+        kind: i32,
+        a: u32,
+        b: u32,
+        c: u32,
+        d: u32,
+        e: u32,
+        f: u32,
+        g: u32,
+    ) -> PyResult<Option<PyObject>> {
+        let kind = string_kind(kind)?;
+        let fields = [a, b, c, d, e, f, g];
+        Ok(self
+            .raw
+            .field(&record.raw, fields, kind)
+            .map(|b| PyBytes::new(py, b).to_object(py)))
+    }
+}
+
+fn string_kind(kind: i32) -> PyResult<rbash::StringKind> {
+    rbash::StringKind::try_from(kind)
+        .map_err(|_| PyErr::new::<ValueError, _>("Incorrect StringKind value."))
+}
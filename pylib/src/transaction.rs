@@ -0,0 +1,52 @@
+use pyo3::class::PyContextProtocol;
+use pyo3::prelude::*;
+use pyo3::types::{PyAny, PyType};
+use pyo3::AsPyPointer;
+
+use rbash;
+
+#[pyclass(module = "rbash")]
+pub struct Transaction {
+    pub(super) raw: Option<rbash::Transaction>,
+}
+
+#[pymethods]
+impl Transaction {
+    fn changed_num(&self) -> usize {
+        self.raw.as_ref().map_or(0, |t| t.changed_num())
+    }
+
+    fn commit(&mut self) {
+        if let Some(t) = self.raw.take() {
+            t.commit()
+        }
+    }
+
+    fn rollback(&mut self) {
+        if let Some(t) = self.raw.take() {
+            t.rollback()
+        }
+    }
+}
+
+#[pyproto]
+impl<'p> PyContextProtocol<'p> for Transaction {
+    fn __enter__(&mut self) -> PyResult<PyObject> {
+        // `with ... as t` binds the transaction itself
+        let py = unsafe { Python::assume_gil_acquired() };
+        Ok(unsafe { PyObject::from_borrowed_ptr(py, self.as_ptr()) })
+    }
+
+    fn __exit__(
+        &mut self,
+        ty: Option<&'p PyType>,
+        _value: Option<&'p PyAny>,
+        _traceback: Option<&'p PyAny>,
+    ) -> PyResult<bool> {
+        match ty {
+            Some(_) => self.rollback(),
+            None => self.commit(),
+        }
+        Ok(false)
+    }
+}